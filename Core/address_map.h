@@ -0,0 +1,120 @@
+#pragma once
+#include <vector>
+
+#include "common.h"
+
+namespace RV32IM
+{
+	// open addressing hash map with linear probing, sized for hot path lookups keyed by guest addresses
+	template <typename K, typename V>
+	class AddressMap
+	{
+	public:
+		AddressMap(size_t initial_capacity = 1024);
+
+		V& operator[](K key);
+		const V* find(K key) const;
+		void clear();
+
+		[[nodiscard]] size_t size() const;
+
+		template <typename F>
+		void for_each(F&& function) const;
+
+	private:
+		struct Slot
+		{
+			K key;
+			bool used;
+			V value;
+		};
+
+		[[nodiscard]] size_t get_slot(K key) const;
+		void grow();
+
+		vector<Slot> slots;
+		size_t count;
+	};
+
+	template <typename K, typename V>
+	AddressMap<K, V>::AddressMap(const size_t initial_capacity) : count(0)
+	{
+		size_t capacity = 16;
+		while (capacity < initial_capacity)
+			capacity <<= 1;
+		slots = vector<Slot>(capacity, Slot{ K{}, false, V{} });
+	}
+
+	template <typename K, typename V>
+	V& AddressMap<K, V>::operator[](const K key)
+	{
+		size_t slot = get_slot(key);
+		if (slots[slot].used)
+			return slots[slot].value;
+
+		// keep the load factor at or below 1/2 so probe sequences stay short
+		if ((count + 1) * 2 > slots.size())
+		{
+			grow();
+			slot = get_slot(key);
+		}
+		slots[slot] = Slot{ key, true, V{} };
+		count++;
+		return slots[slot].value;
+	}
+
+	template <typename K, typename V>
+	const V* AddressMap<K, V>::find(const K key) const
+	{
+		const size_t slot = get_slot(key);
+		return slots[slot].used ? &slots[slot].value : nullptr;
+	}
+
+	template <typename K, typename V>
+	void AddressMap<K, V>::clear()
+	{
+		for (auto& slot : slots)
+			slot = Slot{ K{}, false, V{} };
+		count = 0;
+	}
+
+	template <typename K, typename V>
+	size_t AddressMap<K, V>::size() const
+	{
+		return count;
+	}
+
+	template <typename K, typename V>
+	template <typename F>
+	void AddressMap<K, V>::for_each(F&& function) const
+	{
+		for (const auto& slot : slots)
+		{
+			if (slot.used)
+				function(slot.key, slot.value);
+		}
+	}
+
+	template <typename K, typename V>
+	size_t AddressMap<K, V>::get_slot(const K key) const
+	{
+		// fibonacci hashing spreads word aligned addresses across the table
+		const size_t mask = slots.size() - 1;
+		size_t slot = static_cast<size_t>((static_cast<uint64_t>(key) * 0x9E3779B97F4A7C15ull) >> 32) & mask;
+		while (slots[slot].used && slots[slot].key != key)
+			slot = (slot + 1) & mask;
+		return slot;
+	}
+
+	template <typename K, typename V>
+	void AddressMap<K, V>::grow()
+	{
+		vector<Slot> old_slots(slots.size() * 2, Slot{ K{}, false, V{} });
+		swap(slots, old_slots);
+		for (const auto& slot : old_slots)
+		{
+			if (slot.used)
+				slots[get_slot(slot.key)] = slot;
+		}
+	}
+}
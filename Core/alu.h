@@ -11,8 +11,6 @@ namespace RV32IM
 	{
 	public:
 		static unsigned_data get_result(const Instruction& instruction, unsigned_data rs1, unsigned_data rs2, unsigned_data pc);
-	private:
-		static unsigned_data get_calculation(const Instruction& instruction, unsigned_data rs1, unsigned_data rs2, unsigned_data pc=0x0);
 	};
 
 	
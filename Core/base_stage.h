@@ -14,6 +14,8 @@ namespace RV32IM
 			BaseStage(Core* core) : core(core) {}
 			virtual void clock() = 0;
 			virtual void run() = 0;
+			// back to the constructed state, without reallocating the stage
+			virtual void reset() = 0;
 		protected:
 			Core* core;
 		};
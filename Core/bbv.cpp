@@ -0,0 +1,66 @@
+#include "bbv.h"
+
+#include <algorithm>
+
+namespace RV32IM
+{
+	BbvCollector::BbvCollector(const string& file_path, const uint64_t interval) :
+		interval(interval == 0 ? DEFAULT_INTERVAL : interval), interval_instructions(0), intervals_written(0), block_start(0), block_length(0)
+	{
+		file.open(file_path, ios::trunc);
+		if (!file)
+			throw BbvError("Unable to open BBV file!");
+	}
+
+	BbvCollector::~BbvCollector()
+	{
+		if (block_length > 0)
+			end_block();
+		if (interval_instructions > 0)
+			write_interval();
+	}
+
+	void BbvCollector::end_block()
+	{
+		uint32_t& id = block_ids[block_start];
+		if (id == 0)
+		{
+			block_addresses.push_back(block_start);
+			counts.push_back(0);
+			id = static_cast<uint32_t>(block_addresses.size());
+		}
+		if (counts[id - 1] == 0)
+			touched.push_back(id);
+		counts[id - 1] += block_length;
+		interval_instructions += block_length;
+		block_length = 0;
+
+		if (interval_instructions >= interval)
+			write_interval();
+	}
+
+	void BbvCollector::write_interval()
+	{
+		ranges::sort(touched);
+		file << 'T';
+		for (const uint32_t id : touched)
+		{
+			file << ':' << id << ':' << counts[id - 1] << ' ';
+			counts[id - 1] = 0;
+		}
+		file << '\n';
+		touched.clear();
+		interval_instructions = 0;
+		intervals_written++;
+	}
+
+	uint64_t BbvCollector::get_intervals_written() const
+	{
+		return intervals_written;
+	}
+
+	const vector<unsigned_data>& BbvCollector::get_block_addresses() const
+	{
+		return block_addresses;
+	}
+}
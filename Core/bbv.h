@@ -0,0 +1,68 @@
+#pragma once
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "address_map.h"
+#include "common.h"
+
+namespace RV32IM
+{
+	class BbvError : public exception
+	{
+	public:
+		explicit BbvError(string message) : message(std::move(message)) {}
+
+		const char* what() const noexcept override
+		{
+			return message.c_str();
+		}
+
+	private:
+		string message;
+	};
+
+	// Counts the instructions executed in every basic block and writes one line per interval in the SimPoint .bb format:
+	//   T:<block id>:<instructions> :<block id>:<instructions> ...
+	// A block runs from the instruction after a branch or jump, taken or not, up to and including the next one.
+	// Ids are handed out from 1 in order of first execution, a block counts towards the interval it ends in.
+	class BbvCollector
+	{
+	public:
+		static constexpr uint64_t DEFAULT_INTERVAL = 10000000;
+
+		BbvCollector(const string& file_path, uint64_t interval = DEFAULT_INTERVAL);
+		// writes the last, partial interval
+		~BbvCollector();
+
+		void on_instruction(const unsigned_data pc, const bool ends_block)
+		{
+			if (block_length++ == 0)
+				block_start = pc;
+			if (ends_block)
+				end_block();
+		}
+
+		[[nodiscard]] uint64_t get_intervals_written() const;
+		// start address of every block, indexed by id - 1
+		[[nodiscard]] const vector<unsigned_data>& get_block_addresses() const;
+
+	private:
+		void end_block();
+		void write_interval();
+
+		ofstream file;
+		uint64_t interval;
+		uint64_t interval_instructions;
+		uint64_t intervals_written;
+
+		unsigned_data block_start;
+		uint64_t block_length;
+
+		AddressMap<unsigned_data, uint32_t> block_ids;
+		vector<unsigned_data> block_addresses;
+		// instructions per block in the current interval and the ids with a nonzero count
+		vector<uint64_t> counts;
+		vector<uint32_t> touched;
+	};
+}
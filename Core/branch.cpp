@@ -1,41 +1,320 @@
 #include "branch.h"
 
+#include <algorithm>
+
 namespace RV32IM
 {
-	BranchPrediction::BranchPrediction() : BranchPrediction(0x100000) {}
+	namespace
+	{
+		bool predict(const CounterTable& table, const size_t index, const unsigned_data address)
+		{
+			// an entry owned by another branch has no opinion, fall back to not taken
+			if (!table.matches(index, address))
+				return false;
+			return table.read(index) >= 0b10;
+		}
+
+		void train(CounterTable& table, const size_t index, const unsigned_data address, const bool branch_taken)
+		{
+			if (table.matches(index, address))
+				table.update(index, branch_taken);
+			else
+				table.allocate(index, address, branch_taken);
+		}
+	}
+
+	BranchPredictor::BranchPredictor() : hits(0), misses(0) {}
+
+	void BranchPredictor::reset()
+	{
+		hits = 0;
+		misses = 0;
+	}
+
+	void BranchPredictor::record_prediction(const bool correct)
+	{
+		if (correct)
+			hits++;
+		else
+			misses++;
+	}
+
+	uint64_t BranchPredictor::get_hits() const
+	{
+		return hits;
+	}
+
+	uint64_t BranchPredictor::get_misses() const
+	{
+		return misses;
+	}
+
+	double BranchPredictor::get_accuracy() const
+	{
+		if (hits + misses == 0)
+			return 0.0;
+		return static_cast<double>(hits) / static_cast<double>(hits + misses);
+	}
+
+	bool StaticPredictor::take_branch(const unsigned_data address, const unsigned_data target) const
+	{
+		// loops branch backwards, so assume they are taken
+		return target < address;
+	}
+
+	void StaticPredictor::update_table(unsigned_data, bool) {}
+
+	size_t StaticPredictor::get_table_size() const
+	{
+		return 0;
+	}
+
+	BimodalPredictor::BimodalPredictor(const PredictorConfig& config, const PageBacking backing) :
+		counter_table(config.entries, config.tag_bits, backing) {}
+
+	bool BimodalPredictor::take_branch(const unsigned_data address, unsigned_data) const
+	{
+		return predict(counter_table, counter_table.get_index(address), address);
+	}
+
+	void BimodalPredictor::update_table(const unsigned_data address, const bool branch_taken)
+	{
+		train(counter_table, counter_table.get_index(address), address, branch_taken);
+	}
+
+	size_t BimodalPredictor::get_table_size() const
+	{
+		return counter_table.get_table_size();
+	}
+
+	void BimodalPredictor::reset()
+	{
+		BranchPredictor::reset();
+		counter_table.reset();
+	}
+
+	GSharePredictor::GSharePredictor(const PredictorConfig& config, const PageBacking backing) :
+		counter_table(config.entries, config.tag_bits, backing), global_history(0) {}
+
+	bool GSharePredictor::take_branch(const unsigned_data address, unsigned_data) const
+	{
+		return predict(counter_table, get_index(address), address);
+	}
+
+	void GSharePredictor::update_table(const unsigned_data address, const bool branch_taken)
+	{
+		train(counter_table, get_index(address), address, branch_taken);
+		global_history = global_history << 1 | (branch_taken ? 1 : 0);
+	}
+
+	size_t GSharePredictor::get_table_size() const
+	{
+		return counter_table.get_table_size();
+	}
+
+	void GSharePredictor::reset()
+	{
+		BranchPredictor::reset();
+		counter_table.reset();
+		global_history = 0;
+	}
+
+	size_t GSharePredictor::get_index(const unsigned_data address) const
+	{
+		return (counter_table.get_index(address) ^ global_history) & (counter_table.get_entries() - 1);
+	}
 
-	BranchPrediction::BranchPrediction(const size_t& memory_size) : branch_status_table(new uint8_t[memory_size]), branch_history_table(new uint8_t[memory_size]), memory_size(memory_size)
+	LocalHistoryPredictor::LocalHistoryPredictor(const PredictorConfig& config, const PageBacking backing) :
+		branch_status_table(config.entries, config.tag_bits, backing),
+		branch_history_table(branch_status_table.get_entries() >> 2, 0, backing)
 	{
-		memset(branch_status_table.get(), 0, sizeof(uint8_t) * memory_size);
-		memset(branch_history_table.get(), 0, sizeof(uint8_t) * memory_size);
 	}
 
-	bool BranchPrediction::take_branch(unsigned_data address) const
+	bool LocalHistoryPredictor::take_branch(const unsigned_data address, unsigned_data) const
 	{
-		// 00 strong no branch
-		// 01 weak no branch
-		// 10 weak branch
-		// 11 strong branch
 		// uses branch history as factor to adjust branch behavior
-		// uses 4 status entries per word (works since all branches must be word boundary aligned)
-		address &= (memory_size - 1);
-		return branch_status_table[address + (branch_history_table[address] & 0b11)] >= 0b10;
+		// uses 4 status entries per branch, one for each value of the last 2 outcomes
+		const size_t history_index = get_history_index(address);
+		return predict(branch_status_table, history_index << 2 | (branch_history_table[history_index] & 0b11), address);
+	}
+
+	void LocalHistoryPredictor::update_table(const unsigned_data address, const bool branch_taken)
+	{
+		const size_t history_index = get_history_index(address);
+		train(branch_status_table, history_index << 2 | (branch_history_table[history_index] & 0b11), address, branch_taken);
+		branch_history_table[history_index] = static_cast<uint8_t>(branch_history_table[history_index] << 1 | (branch_taken ? 1 : 0));
+	}
+
+	size_t LocalHistoryPredictor::get_table_size() const
+	{
+		return branch_status_table.get_table_size() + branch_history_table.size() * sizeof(uint8_t);
+	}
+
+	void LocalHistoryPredictor::reset()
+	{
+		BranchPredictor::reset();
+		branch_status_table.reset();
+		ranges::fill(branch_history_table, 0);
+	}
+
+	size_t LocalHistoryPredictor::get_history_index(const unsigned_data address) const
+	{
+		// indexed by the PC itself, dropping status index bits would give neighbouring branches one shared history
+		const size_t history_bits = branch_status_table.get_index_bits() - 2;
+		const unsigned_data halfword = address >> 1;
+		return (halfword ^ (halfword >> history_bits)) & (branch_history_table.size() - 1);
+	}
+
+	TagePredictor::TagePredictor(const PredictorConfig& config, const PageBacking backing) :
+		base_table(config.entries, 0, backing), table_bits(0), global_history(0)
+	{
+		// each tagged table gets a quarter of the base table's entries
+		table_bits = base_table.get_index_bits() > 2 ? base_table.get_index_bits() - 2 : 1;
+		for (auto& table : tagged_tables)
+			table = HugePageVector<TageEntry>(static_cast<size_t>(1) << table_bits, TageEntry{ 0, 0, 0 }, backing);
+	}
+
+	bool TagePredictor::take_branch(const unsigned_data address, unsigned_data) const
+	{
+		const int provider = find_provider(address, NUM_TABLES);
+		if (provider < 0)
+			return base_table.read(base_table.get_index(address)) >= 0b10;
+		return tagged_tables[provider][get_index(address, provider)].counter >= 0;
+	}
+
+	void TagePredictor::update_table(const unsigned_data address, const bool branch_taken)
+	{
+		const size_t base_index = base_table.get_index(address);
+		const bool base_prediction = base_table.read(base_index) >= 0b10;
+		const int provider = find_provider(address, NUM_TABLES);
+		bool prediction;
+
+		if (provider < 0)
+		{
+			prediction = base_prediction;
+			base_table.update(base_index, branch_taken);
+		}
+		else
+		{
+			TageEntry& entry = tagged_tables[provider][get_index(address, provider)];
+			prediction = entry.counter >= 0;
+
+			// the provider is only useful when it disagrees with the next shorter history
+			const int alternate = find_provider(address, provider);
+			const bool alternate_prediction = alternate < 0 ?
+				base_prediction :
+				tagged_tables[alternate][get_index(address, alternate)].counter >= 0;
+			if (prediction != alternate_prediction)
+			{
+				if (prediction == branch_taken && entry.useful < 3)
+					entry.useful++;
+				else if (prediction != branch_taken && entry.useful > 0)
+					entry.useful--;
+			}
+
+			// 3-bit signed counter, >= 0 predicts taken
+			if (branch_taken && entry.counter < 3)
+				entry.counter++;
+			else if (!branch_taken && entry.counter > -4)
+				entry.counter--;
+		}
+
+		// on a miss, allocate an entry with a longer history than the provider
+		if (prediction != branch_taken)
+		{
+			bool allocated = false;
+			for (size_t table{ static_cast<size_t>(provider + 1) }; table < NUM_TABLES; table++)
+			{
+				TageEntry& entry = tagged_tables[table][get_index(address, table)];
+				if (entry.useful == 0)
+				{
+					entry = TageEntry{ get_tag(address, table), static_cast<int8_t>(branch_taken ? 0 : -1), 0 };
+					allocated = true;
+					break;
+				}
+			}
+			// age every candidate so a slot frees up for the next miss
+			if (!allocated)
+			{
+				for (size_t table{ static_cast<size_t>(provider + 1) }; table < NUM_TABLES; table++)
+				{
+					TageEntry& entry = tagged_tables[table][get_index(address, table)];
+					if (entry.useful > 0)
+						entry.useful--;
+				}
+			}
+		}
+
+		global_history = global_history << 1 | (branch_taken ? 1 : 0);
+	}
+
+	size_t TagePredictor::get_table_size() const
+	{
+		return base_table.get_table_size() + NUM_TABLES * tagged_tables[0].size() * sizeof(TageEntry);
+	}
+
+	void TagePredictor::reset()
+	{
+		BranchPredictor::reset();
+		base_table.reset();
+		for (auto& table : tagged_tables)
+			ranges::fill(table, TageEntry{ 0, 0, 0 });
+		global_history = 0;
 	}
 
-	void BranchPrediction::update_table(unsigned_data address, const bool branch_taken)
+	int TagePredictor::find_provider(const unsigned_data address, const int below) const
 	{
-		address &= (memory_size - 1);
-		const unsigned_data branch_address = address + (branch_history_table[address] & 0b11);
-		if (branch_taken) 
+		// longest matching history wins
+		for (int table{ below - 1 }; table >= 0; table--)
 		{
-			if (branch_status_table[branch_address] < 3) 
-				branch_status_table[branch_address]++;
+			if (tagged_tables[table][get_index(address, table)].tag == get_tag(address, table))
+				return table;
 		}
-		else 
+		return -1;
+	}
+
+	size_t TagePredictor::get_index(const unsigned_data address, const size_t table) const
+	{
+		return ((address >> 1) ^ (address >> (1 + table_bits)) ^ fold_history(HISTORY_LENGTHS[table], table_bits)) &
+			((static_cast<size_t>(1) << table_bits) - 1);
+	}
+
+	uint8_t TagePredictor::get_tag(const unsigned_data address, const size_t table) const
+	{
+		// use a different fold width than the index so tag and index alias differently
+		// tag 0 marks an empty entry
+		const auto tag = static_cast<uint8_t>(((address >> 1) ^ fold_history(HISTORY_LENGTHS[table], TAG_BITS - 1) << 1) &
+			((1 << TAG_BITS) - 1));
+		return tag == 0 ? 1 : tag;
+	}
+
+	uint64_t TagePredictor::fold_history(const size_t length, const size_t bits) const
+	{
+		uint64_t history = length >= 64 ? global_history : global_history & ((1ull << length) - 1);
+		uint64_t folded = 0;
+		while (history != 0)
+		{
+			folded ^= history & ((1ull << bits) - 1);
+			history >>= bits;
+		}
+		return folded;
+	}
+
+	unique_ptr<BranchPredictor> make_branch_predictor(const PredictorConfig& config, const PageBacking backing)
+	{
+		switch (config.type)
 		{
-			if (branch_status_table[branch_address] > 0) 
-				branch_status_table[branch_address]--;
+		case PredictorType::STATIC:
+			return make_unique<StaticPredictor>();
+		case PredictorType::BIMODAL:
+			return make_unique<BimodalPredictor>(config, backing);
+		case PredictorType::GSHARE:
+			return make_unique<GSharePredictor>(config, backing);
+		case PredictorType::TAGE:
+			return make_unique<TagePredictor>(config, backing);
+		case PredictorType::LOCAL:
+		default:
+			return make_unique<LocalHistoryPredictor>(config, backing);
 		}
-		branch_history_table[address] = branch_history_table[address] << 1 | (branch_taken ? 1 : 0);
 	}
 }
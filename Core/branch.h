@@ -1,20 +1,132 @@
 #pragma once
+#include <array>
 #include <memory>
+#include <vector>
 
 #include "common.h"
+#include "counter_table.h"
 
 namespace RV32IM
 {
-	class BranchPrediction
+	enum class PredictorType { STATIC, BIMODAL, GSHARE, LOCAL, TAGE };
+
+	struct PredictorConfig
+	{
+		PredictorType type = PredictorType::LOCAL;
+		size_t entries = 4096;	// counters per table, rounded up to a power of 2
+		size_t tag_bits = 0;	// 0 disables tags
+		size_t btb_entries = 256;	// 0 disables the branch target buffer
+		size_t ras_depth = 16;	// 0 disables the return address stack
+	};
+
+	class BranchPredictor
 	{
 	public:
-		BranchPrediction();
-		BranchPrediction(const size_t& memory_size);
-		bool take_branch(unsigned_data address) const;
-		void update_table(unsigned_data address, bool branch_taken);
+		BranchPredictor();
+		virtual ~BranchPredictor() = default;
+
+		virtual bool take_branch(unsigned_data address, unsigned_data target) const = 0;
+		virtual void update_table(unsigned_data address, bool branch_taken) = 0;
+		[[nodiscard]] virtual size_t get_table_size() const = 0;
+		// clears the tables and statistics in place, keeping their storage
+		virtual void reset();
+
+		void record_prediction(bool correct);
+		[[nodiscard]] uint64_t get_hits() const;
+		[[nodiscard]] uint64_t get_misses() const;
+		[[nodiscard]] double get_accuracy() const;
+
 	private:
-		unique_ptr<uint8_t[]> branch_status_table;
-		unique_ptr<uint8_t[]> branch_history_table;
-		size_t memory_size;
+		uint64_t hits;
+		uint64_t misses;
 	};
+
+	// backward taken, forward not taken
+	class StaticPredictor : public BranchPredictor
+	{
+	public:
+		bool take_branch(unsigned_data address, unsigned_data target) const override;
+		void update_table(unsigned_data address, bool branch_taken) override;
+		[[nodiscard]] size_t get_table_size() const override;
+	};
+
+	// one 2-bit counter per hashed branch address
+	class BimodalPredictor : public BranchPredictor
+	{
+	public:
+		BimodalPredictor(const PredictorConfig& config, PageBacking backing = PageBacking::NORMAL);
+		bool take_branch(unsigned_data address, unsigned_data target) const override;
+		void update_table(unsigned_data address, bool branch_taken) override;
+		[[nodiscard]] size_t get_table_size() const override;
+		void reset() override;
+	private:
+		CounterTable counter_table;
+	};
+
+	// 2-bit counters indexed by hashed address xor global history
+	class GSharePredictor : public BranchPredictor
+	{
+	public:
+		GSharePredictor(const PredictorConfig& config, PageBacking backing = PageBacking::NORMAL);
+		bool take_branch(unsigned_data address, unsigned_data target) const override;
+		void update_table(unsigned_data address, bool branch_taken) override;
+		[[nodiscard]] size_t get_table_size() const override;
+		void reset() override;
+	private:
+		size_t get_index(unsigned_data address) const;
+
+		CounterTable counter_table;
+		unsigned_data global_history;
+	};
+
+	// 4 2-bit counters per hashed branch address, selected by 2 bits of local history
+	class LocalHistoryPredictor : public BranchPredictor
+	{
+	public:
+		LocalHistoryPredictor(const PredictorConfig& config, PageBacking backing = PageBacking::NORMAL);
+		bool take_branch(unsigned_data address, unsigned_data target) const override;
+		void update_table(unsigned_data address, bool branch_taken) override;
+		[[nodiscard]] size_t get_table_size() const override;
+		void reset() override;
+	private:
+		size_t get_history_index(unsigned_data address) const;
+
+		CounterTable branch_status_table;
+		HugePageVector<uint8_t> branch_history_table;
+	};
+
+	// bimodal base predictor backed by tagged tables of geometrically increasing history length
+	class TagePredictor : public BranchPredictor
+	{
+	public:
+		static constexpr size_t NUM_TABLES = 4;
+		static constexpr size_t TAG_BITS = 8;
+		static constexpr array<size_t, NUM_TABLES> HISTORY_LENGTHS = { 4, 8, 16, 32 };
+
+		TagePredictor(const PredictorConfig& config, PageBacking backing = PageBacking::NORMAL);
+		bool take_branch(unsigned_data address, unsigned_data target) const override;
+		void update_table(unsigned_data address, bool branch_taken) override;
+		[[nodiscard]] size_t get_table_size() const override;
+		void reset() override;
+	private:
+		struct TageEntry
+		{
+			uint8_t tag;
+			int8_t counter;
+			uint8_t useful;
+		};
+
+		int find_provider(unsigned_data address, int below) const;
+		size_t get_index(unsigned_data address, size_t table) const;
+		uint8_t get_tag(unsigned_data address, size_t table) const;
+		uint64_t fold_history(size_t length, size_t bits) const;
+
+		CounterTable base_table;
+		array<HugePageVector<TageEntry>, NUM_TABLES> tagged_tables;
+		size_t table_bits;
+		uint64_t global_history;
+	};
+
+	// backing is where the tables' host pages come from, see Core::set_page_backing
+	unique_ptr<BranchPredictor> make_branch_predictor(const PredictorConfig& config, PageBacking backing = PageBacking::NORMAL);
 }
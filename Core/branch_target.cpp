@@ -0,0 +1,106 @@
+#include "branch_target.h"
+
+#include <algorithm>
+
+namespace RV32IM
+{
+	BranchTargetBuffer::BranchTargetBuffer(const size_t entries, const PageBacking backing)
+	{
+		// round up so the index can be masked instead of divided
+		size_t size = 1;
+		while (size < entries)
+			size <<= 1;
+		if (entries == 0)
+			size = 0;
+
+		addresses = HugePageVector<unsigned_data>(size, 0, backing);
+		targets = HugePageVector<unsigned_data>(size, 0, backing);
+		valid = vector<bool>(size, false);
+	}
+
+	bool BranchTargetBuffer::lookup(const unsigned_data address, unsigned_data& target) const
+	{
+		if (addresses.empty())
+			return false;
+
+		const size_t index = get_index(address);
+		if (!valid[index] || addresses[index] != address)
+			return false;
+
+		target = targets[index];
+		return true;
+	}
+
+	void BranchTargetBuffer::update(const unsigned_data address, const unsigned_data target)
+	{
+		if (addresses.empty())
+			return;
+
+		const size_t index = get_index(address);
+		addresses[index] = address;
+		targets[index] = target;
+		valid[index] = true;
+	}
+
+	void BranchTargetBuffer::reset()
+	{
+		ranges::fill(addresses, 0);
+		ranges::fill(targets, 0);
+		fill(valid.begin(), valid.end(), false);
+	}
+
+	size_t BranchTargetBuffer::get_table_size() const
+	{
+		return addresses.size() * sizeof(unsigned_data) * 2 + valid.size() / 8;
+	}
+
+	size_t BranchTargetBuffer::get_index(const unsigned_data address) const
+	{
+		// halfword aligned for RVC
+		return (address >> 1) & (addresses.size() - 1);
+	}
+
+	ReturnAddressStack::ReturnAddressStack(const size_t depth) : entries(depth, 0), top(0), count(0) {}
+
+	void ReturnAddressStack::push(const unsigned_data address)
+	{
+		if (entries.empty())
+			return;
+
+		top = (top + 1) % entries.size();
+		entries[top] = address;
+		if (count < entries.size())
+			count++;
+	}
+
+	bool ReturnAddressStack::pop(unsigned_data& address)
+	{
+		if (count == 0)
+			return false;
+
+		address = entries[top];
+		top = (top + entries.size() - 1) % entries.size();
+		count--;
+		return true;
+	}
+
+	void ReturnAddressStack::reset()
+	{
+		ranges::fill(entries, 0);
+		top = 0;
+		count = 0;
+	}
+
+	ReturnStackCheckpoint ReturnAddressStack::checkpoint() const
+	{
+		return { top, count, entries.empty() ? 0 : entries[top] };
+	}
+
+	void ReturnAddressStack::restore(const ReturnStackCheckpoint& checkpoint)
+	{
+		top = checkpoint.top;
+		count = checkpoint.count;
+		if (!entries.empty())
+			entries[top] = checkpoint.address;
+	}
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <vector>
+
+#include "common.h"
+#include "host_memory.h"
+
+namespace RV32IM
+{
+	// direct mapped cache of the last target seen for each indirect jump
+	class BranchTargetBuffer
+	{
+	public:
+		BranchTargetBuffer(size_t entries, PageBacking backing = PageBacking::NORMAL);
+
+		bool lookup(unsigned_data address, unsigned_data& target) const;
+		void update(unsigned_data address, unsigned_data target);
+		void reset();
+
+		[[nodiscard]] size_t get_table_size() const;
+
+	private:
+		[[nodiscard]] size_t get_index(unsigned_data address) const;
+
+		HugePageVector<unsigned_data> addresses;
+		HugePageVector<unsigned_data> targets;
+		vector<bool> valid;
+	};
+
+	// what a squashed instruction may have changed: at most two pushes or pops move top and overwrite the entry above it
+	struct ReturnStackCheckpoint
+	{
+		size_t top;
+		size_t count;
+		unsigned_data address;
+	};
+
+	// circular stack of return addresses, the oldest entry is overwritten on overflow
+	class ReturnAddressStack
+	{
+	public:
+		ReturnAddressStack(size_t depth);
+
+		void push(unsigned_data address);
+		bool pop(unsigned_data& address);
+		void reset();
+
+		// fetch pushes and pops speculatively, so wrong-path instructions are undone from a checkpoint
+		[[nodiscard]] ReturnStackCheckpoint checkpoint() const;
+		void restore(const ReturnStackCheckpoint& checkpoint);
+
+	private:
+		vector<unsigned_data> entries;
+		size_t top;
+		size_t count;
+	};
+}
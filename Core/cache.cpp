@@ -0,0 +1,232 @@
+#include "cache.h"
+
+#include <algorithm>
+
+namespace RV32IM
+{
+	namespace
+	{
+		// bits needed to index value rounded up to a power of 2
+		size_t ceil_log2(const size_t value)
+		{
+			size_t bits = 0;
+			while ((static_cast<size_t>(1) << bits) < value)
+				bits++;
+			return bits;
+		}
+	}
+
+	Cache::Cache(const CacheConfig& config) : policy(config.policy), hits(0), misses(0), writebacks(0)
+	{
+		// round up so the set and tag can be taken with shifts and masks
+		line_bits = max(ceil_log2(config.line_size), static_cast<size_t>(2));
+		const size_t size_bits = max(ceil_log2(config.size), line_bits);
+		way_bits = min({ ceil_log2(max(config.ways, static_cast<size_t>(1))), static_cast<size_t>(5), size_bits - line_bits });
+		set_bits = size_bits - line_bits - way_bits;
+		ways = static_cast<size_t>(1) << way_bits;
+
+		lines = vector<uint32_t>(ways << set_bits, 0);
+		if (policy == ReplacementPolicy::LRU)
+			ages = vector<uint8_t>(ways << set_bits, 0);
+		else
+			trees = vector<uint32_t>(static_cast<size_t>(1) << set_bits, 0);
+		reset();
+	}
+
+	bool Cache::access(const unsigned_data address, const bool write, bool& writeback, unsigned_data& writeback_address)
+	{
+		writeback = false;
+		const unsigned_data line_address = address >> line_bits;
+		const size_t set = line_address & ((static_cast<size_t>(1) << set_bits) - 1);
+		const uint32_t tag = static_cast<uint32_t>(line_address >> set_bits) << 2 | VALID;
+		uint32_t* set_lines = &lines[set << way_bits];
+
+		for (size_t way = 0; way < ways; way++)
+		{
+			if ((set_lines[way] & ~DIRTY) == tag)
+			{
+				if (write)
+					set_lines[way] |= DIRTY;
+				touch(set, way);
+				hits++;
+				return true;
+			}
+		}
+
+		const size_t victim = find_victim(set);
+		if ((set_lines[victim] & (VALID | DIRTY)) == (VALID | DIRTY))
+		{
+			writeback = true;
+			writeback_address = static_cast<unsigned_data>(((set_lines[victim] >> 2) << set_bits | set) << line_bits);
+			writebacks++;
+		}
+		set_lines[victim] = write ? tag | DIRTY : tag;
+		touch(set, victim);
+		misses++;
+		return false;
+	}
+
+	void Cache::reset()
+	{
+		ranges::fill(lines, 0);
+		// every set starts out as a permutation of the ages so the oldest way is always unique
+		for (size_t index = 0; index < ages.size(); index++)
+			ages[index] = static_cast<uint8_t>(index & (ways - 1));
+		ranges::fill(trees, 0);
+		hits = 0;
+		misses = 0;
+		writebacks = 0;
+	}
+
+	void Cache::touch(const size_t set, const size_t way)
+	{
+		if (policy == ReplacementPolicy::LRU)
+		{
+			uint8_t* set_ages = &ages[set << way_bits];
+			const uint8_t age = set_ages[way];
+			for (size_t other = 0; other < ways; other++)
+				if (set_ages[other] < age)
+					set_ages[other]++;
+			set_ages[way] = 0;
+			return;
+		}
+
+		// walk from the root to the way and point every node on the path at the other half
+		uint32_t& tree = trees[set];
+		size_t node = 1;
+		for (size_t level = way_bits; level > 0; level--)
+		{
+			const size_t direction = way >> (level - 1) & 1;
+			if (direction)
+				tree &= ~(1u << node);
+			else
+				tree |= 1u << node;
+			node = node << 1 | direction;
+		}
+	}
+
+	size_t Cache::find_victim(const size_t set) const
+	{
+		const uint32_t* set_lines = &lines[set << way_bits];
+		for (size_t way = 0; way < ways; way++)
+			if (!(set_lines[way] & VALID))
+				return way;
+
+		if (policy == ReplacementPolicy::LRU)
+		{
+			const uint8_t* set_ages = &ages[set << way_bits];
+			return static_cast<size_t>(ranges::find(set_ages, set_ages + ways, static_cast<uint8_t>(ways - 1)) - set_ages);
+		}
+
+		size_t node = 1;
+		while (node < ways)
+			node = node << 1 | (trees[set] >> node & 1);
+		return node - ways;
+	}
+
+	uint64_t Cache::get_hits() const
+	{
+		return hits;
+	}
+
+	uint64_t Cache::get_misses() const
+	{
+		return misses;
+	}
+
+	uint64_t Cache::get_writebacks() const
+	{
+		return writebacks;
+	}
+
+	double Cache::get_hit_rate() const
+	{
+		const uint64_t accesses = hits + misses;
+		return accesses == 0 ? 0.0 : static_cast<double>(hits) / static_cast<double>(accesses);
+	}
+
+	size_t Cache::get_sets() const
+	{
+		return static_cast<size_t>(1) << set_bits;
+	}
+
+	size_t Cache::get_ways() const
+	{
+		return ways;
+	}
+
+	CacheHierarchy::CacheHierarchy(const CacheHierarchyConfig& config) : config(config), l1i(config.l1i), l1d(config.l1d), l2(config.l2),
+		l1i_line_size(static_cast<size_t>(1) << max(ceil_log2(config.l1i.line_size), static_cast<size_t>(2))), pending_stall(0), stall_cycles(0)
+	{
+	}
+
+	void CacheHierarchy::fetch(const unsigned_data address, const unsigned_data length)
+	{
+		access(l1i, address, false);
+		// a 32 bit instruction on a halfword boundary may straddle two lines
+		const unsigned_data last = address + length - 1;
+		if ((address ^ last) & ~static_cast<unsigned_data>(l1i_line_size - 1))
+			access(l1i, last, false);
+	}
+
+	void CacheHierarchy::load(const unsigned_data address)
+	{
+		access(l1d, address, false);
+	}
+
+	void CacheHierarchy::store(const unsigned_data address)
+	{
+		access(l1d, address, true);
+	}
+
+	void CacheHierarchy::access(Cache& l1, const unsigned_data address, const bool write)
+	{
+		bool writeback;
+		unsigned_data victim;
+		if (l1.access(address, write, writeback, victim))
+			return;
+
+		// dirty L1 victims drain through a write buffer and only change the state of L2, as do L2's own victims
+		bool memory_writeback;
+		unsigned_data memory_victim;
+		if (writeback)
+			l2.access(victim, true, memory_writeback, memory_victim);
+		pending_stall += config.l2_latency;
+		if (!l2.access(address, false, memory_writeback, memory_victim))
+			pending_stall += config.memory_latency;
+	}
+
+	void CacheHierarchy::reset()
+	{
+		l1i.reset();
+		l1d.reset();
+		l2.reset();
+		pending_stall = 0;
+		stall_cycles = 0;
+	}
+
+	const Cache& CacheHierarchy::get_l1i() const
+	{
+		return l1i;
+	}
+
+	const Cache& CacheHierarchy::get_l1d() const
+	{
+		return l1d;
+	}
+
+	const Cache& CacheHierarchy::get_l2() const
+	{
+		return l2;
+	}
+
+	const CacheHierarchyConfig& CacheHierarchy::get_config() const
+	{
+		return config;
+	}
+
+	uint64_t CacheHierarchy::get_stall_cycles() const
+	{
+		return stall_cycles;
+	}
+}
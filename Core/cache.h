@@ -0,0 +1,106 @@
+#pragma once
+#include <vector>
+
+#include "common.h"
+
+namespace RV32IM
+{
+	enum class ReplacementPolicy : uint8_t { LRU, PLRU };
+
+	struct CacheConfig
+	{
+		size_t size = 4096;	// bytes, rounded up to a power of 2
+		size_t line_size = 32;	// bytes, rounded up to a power of 2 of at least 4
+		size_t ways = 2;	// rounded up to a power of 2, at most 32 and at most one line per way
+		ReplacementPolicy policy = ReplacementPolicy::LRU;
+	};
+
+	struct CacheHierarchyConfig
+	{
+		CacheConfig l1i = { 4096, 32, 2, ReplacementPolicy::LRU };
+		CacheConfig l1d = { 4096, 32, 4, ReplacementPolicy::LRU };
+		CacheConfig l2 = { 65536, 64, 8, ReplacementPolicy::PLRU };
+		uint32_t l2_latency = 8;	// stall cycles of an L1 miss that hits in L2
+		uint32_t memory_latency = 40;	// further stall cycles when L2 misses as well
+	};
+
+	// set associative, write back, write allocate cache that only keeps tags, the data always lives in UnifiedMemory
+	class Cache
+	{
+	public:
+		Cache(const CacheConfig& config);
+
+		// returns whether the line was present, a miss allocates it and reports a dirty victim through writeback
+		bool access(unsigned_data address, bool write, bool& writeback, unsigned_data& writeback_address);
+		void reset();
+
+		[[nodiscard]] uint64_t get_hits() const;
+		[[nodiscard]] uint64_t get_misses() const;
+		[[nodiscard]] uint64_t get_writebacks() const;
+		[[nodiscard]] double get_hit_rate() const;
+		[[nodiscard]] size_t get_sets() const;
+		[[nodiscard]] size_t get_ways() const;
+
+	private:
+		static constexpr uint32_t VALID = 0x1;
+		static constexpr uint32_t DIRTY = 0x2;
+
+		void touch(size_t set, size_t way);
+		[[nodiscard]] size_t find_victim(size_t set) const;
+
+		// one word per line: tag << 2 | DIRTY | VALID, the sets are laid out one after another
+		vector<uint32_t> lines;
+		// LRU keeps the age of every way, 0 being the most recent, PLRU one tree of direction bits per set
+		vector<uint8_t> ages;
+		vector<uint32_t> trees;
+		ReplacementPolicy policy;
+		size_t ways;
+		size_t way_bits;
+		size_t set_bits;
+		size_t line_bits;
+		uint64_t hits;
+		uint64_t misses;
+		uint64_t writebacks;
+	};
+
+	// private L1 instruction and data caches in front of a unified L2. Misses add stall cycles that freeze the whole
+	// pipeline, every clock spent waiting is taken off them by stalled().
+	class CacheHierarchy
+	{
+	public:
+		CacheHierarchy(const CacheHierarchyConfig& config);
+
+		void fetch(unsigned_data address, unsigned_data length);
+		void load(unsigned_data address);
+		void store(unsigned_data address);
+		// called once per clock, true while the pipeline waits for a miss
+		bool stalled()
+		{
+			if (pending_stall == 0)
+				return false;
+			pending_stall--;
+			stall_cycles++;
+			return true;
+		}
+		// drops the wait for misses no pipeline took, e.g. while warming functionally, without counting it
+		void discard_stall() { pending_stall = 0; }
+		void reset();
+
+		[[nodiscard]] const Cache& get_l1i() const;
+		[[nodiscard]] const Cache& get_l1d() const;
+		[[nodiscard]] const Cache& get_l2() const;
+		[[nodiscard]] const CacheHierarchyConfig& get_config() const;
+		[[nodiscard]] uint64_t get_stall_cycles() const;
+
+	private:
+		void access(Cache& l1, unsigned_data address, bool write);
+
+		CacheHierarchyConfig config;
+		Cache l1i;
+		Cache l1d;
+		Cache l2;
+		size_t l1i_line_size;
+		uint32_t pending_stall;
+		uint64_t stall_cycles;
+	};
+}
@@ -1,4 +1,5 @@
 #pragma once
+#include <cassert>
 #include <cstdint>
 #include <string>
 #include <map>
@@ -51,7 +52,9 @@ namespace RV32IM
 		LX = 0b0000011,
 		SX = 0b0100011,
 		RI = 0b0010011,
-		RR = 0b0110011
+		RR = 0b0110011,
+		AMO = 0b0101111,
+		SYSTEM = 0b1110011
 	};
 
 	enum Funct3
@@ -87,7 +90,14 @@ namespace RV32IM
 		BLT		= 0x4,
 		BGE		= 0x5,
 		BLTU	= 0x6,
-		BGEU	= 0x7
+		BGEU	= 0x7,
+		PRIV	= 0x0,
+		CSRRW	= 0x1,
+		CSRRS	= 0x2,
+		CSRRC	= 0x3,
+		CSRRWI	= 0x5,
+		CSRRSI	= 0x6,
+		CSRRCI	= 0x7
 	};
 
 	enum Funct7
@@ -97,6 +107,40 @@ namespace RV32IM
 		M_EXT	= 0x01
 	};
 
+	// bits 31:27 of an A extension instruction, bits 26:25 hold the aq/rl ordering hints
+	enum AtomicFunct5
+	{
+		AMOADD_W	= 0x00,
+		AMOSWAP_W	= 0x01,
+		LR_W		= 0x02,
+		SC_W		= 0x03,
+		AMOXOR_W	= 0x04,
+		AMOOR_W		= 0x08,
+		AMOAND_W	= 0x0C,
+		AMOMIN_W	= 0x10,
+		AMOMAX_W	= 0x14,
+		AMOMINU_W	= 0x18,
+		AMOMAXU_W	= 0x1C
+	};
+
+	// Zicntr counters plus the first Zihpm counters, which report pipeline events, and the hart id
+	enum CSRAddress
+	{
+		CYCLE		= 0xC00,
+		TIME		= 0xC01,
+		INSTRET		= 0xC02,
+		HPM_STALL	= 0xC03,
+		HPM_MISPREDICT	= 0xC04,
+		HPM_BUBBLE	= 0xC05,
+		CYCLEH		= 0xC80,
+		TIMEH		= 0xC81,
+		INSTRETH	= 0xC82,
+		HPM_STALLH	= 0xC83,
+		HPM_MISPREDICTH	= 0xC84,
+		HPM_BUBBLEH	= 0xC85,
+		MHARTID		= 0xF14
+	};
+
 	enum RegisterName
 	{
 		zero, ra, sp, gp, tp, t0, t1, t2, s0, s1, a0, a1, a2, a3, a4, a5,
@@ -151,8 +195,25 @@ namespace RV32IM
 
 	enum class InstructionFormat { R, I, S, B, U, J };
 
-	constexpr unsigned_data generate_bitmask(size_t bit_width);
-	unsigned_data mask_data(unsigned_data data, size_t low_bit, size_t high_bit);
-	unsigned_data sign_extend(unsigned_data data, size_t space);
+	constexpr unsigned_data generate_bitmask(const size_t bit_width)
+	{
+		assert(bit_width <= 32);
+		return bit_width == 32 ? 0xFFFFFFFF : (1u << bit_width) - 1;
+	}
+
+	constexpr unsigned_data mask_data(const unsigned_data data, const size_t low_bit, const size_t high_bit)
+	{
+		assert(high_bit >= low_bit);
+		return (data >> low_bit) & generate_bitmask(high_bit - low_bit + 1);
+	}
+
+	constexpr unsigned_data sign_extend(const unsigned_data data, const size_t space)
+	{
+		assert(data <= 1);
+		assert(space <= 32);
+		return data ? (0xFFFFFFFF << space) : 0;
+	}
+
+	string to_hex(unsigned_data data);
 	void update_offsets(uint32_t memory_size);
 }
@@ -0,0 +1,196 @@
+#include "compressed.h"
+
+namespace RV32IM
+{
+	namespace
+	{
+		// the three bit register fields address x8 to x15
+		RegisterName compact_register(const uint16_t data, const size_t low_bit)
+		{
+			return static_cast<RegisterName>(mask_data(data, low_bit, low_bit + 2) + 8);
+		}
+
+		inst_data encode_r(const Funct3 funct3, const Funct7 funct7, const RegisterName rd, const RegisterName rs1, const RegisterName rs2)
+		{
+			return funct7 << 25 | rs2 << 20 | rs1 << 15 | funct3 << 12 | rd << 7 | RR;
+		}
+
+		inst_data encode_i(const Opcodes opcode, const Funct3 funct3, const RegisterName rd, const RegisterName rs1, const unsigned_data immediate)
+		{
+			return (immediate & 0xFFF) << 20 | rs1 << 15 | funct3 << 12 | rd << 7 | opcode;
+		}
+
+		inst_data encode_s(const RegisterName rs1, const RegisterName rs2, const unsigned_data immediate)
+		{
+			return (immediate >> 5 & 0x7F) << 25 | rs2 << 20 | rs1 << 15 | SW << 12 | (immediate & 0x1F) << 7 | SX;
+		}
+
+		inst_data encode_b(const Funct3 funct3, const RegisterName rs1, const unsigned_data offset)
+		{
+			return (offset >> 12 & 0x1) << 31 | (offset >> 5 & 0x3F) << 25 | zero << 20 | rs1 << 15 | funct3 << 12 |
+				(offset >> 1 & 0xF) << 8 | (offset >> 11 & 0x1) << 7 | BXX;
+		}
+
+		inst_data encode_j(const RegisterName rd, const unsigned_data offset)
+		{
+			return (offset >> 20 & 0x1) << 31 | (offset >> 1 & 0x3FF) << 21 | (offset >> 11 & 0x1) << 20 |
+				(offset >> 12 & 0xFF) << 12 | rd << 7 | JAL;
+		}
+
+		// imm[5] at bit 12 and imm[4:0] at bits 6:2, used by C.ADDI, C.LI, C.ANDI
+		unsigned_data immediate_6(const uint16_t data)
+		{
+			return mask_data(data, 2, 6) | sign_extend(mask_data(data, 12, 12), 5);
+		}
+
+		// C.J and C.JAL: offset[11|4|9:8|10|6|7|3:1|5]
+		unsigned_data jump_offset(const uint16_t data)
+		{
+			return mask_data(data, 3, 5) << 1 | mask_data(data, 11, 11) << 4 | mask_data(data, 2, 2) << 5 |
+				mask_data(data, 7, 7) << 6 | mask_data(data, 6, 6) << 7 | mask_data(data, 9, 10) << 8 |
+				mask_data(data, 8, 8) << 10 | sign_extend(mask_data(data, 12, 12), 11);
+		}
+
+		// C.BEQZ and C.BNEZ: offset[8|4:3] and offset[7:6|2:1|5]
+		unsigned_data branch_offset(const uint16_t data)
+		{
+			return mask_data(data, 3, 4) << 1 | mask_data(data, 10, 11) << 3 | mask_data(data, 2, 2) << 5 |
+				mask_data(data, 5, 6) << 6 | sign_extend(mask_data(data, 12, 12), 8);
+		}
+
+		inst_data expand_quadrant_0(const uint16_t data)
+		{
+			const RegisterName rd = compact_register(data, 2);
+			const RegisterName rs1 = compact_register(data, 7);
+			// C.LW and C.SW: uimm[5:3] at bits 12:10, uimm[2] at bit 6, uimm[6] at bit 5
+			const unsigned_data word_offset = mask_data(data, 6, 6) << 2 | mask_data(data, 10, 12) << 3 | mask_data(data, 5, 5) << 6;
+
+			switch (mask_data(data, 13, 15))
+			{
+			case 0x0:
+			{
+				// C.ADDI4SPN: nzuimm[5:4|9:6|2|3]
+				const unsigned_data immediate = mask_data(data, 6, 6) << 2 | mask_data(data, 5, 5) << 3 |
+					mask_data(data, 11, 12) << 4 | mask_data(data, 7, 10) << 6;
+				return immediate == 0 ? 0 : encode_i(RI, ADD, rd, sp, immediate);
+			}
+			case 0x2:
+				return encode_i(LX, LW, rd, rs1, word_offset);
+			case 0x6:
+				return encode_s(rs1, rd, word_offset);
+			default:
+				return 0;
+			}
+		}
+
+		inst_data expand_quadrant_1(const uint16_t data)
+		{
+			const auto rd = static_cast<RegisterName>(mask_data(data, 7, 11));
+			const RegisterName rd_compact = compact_register(data, 7);
+
+			switch (mask_data(data, 13, 15))
+			{
+			case 0x0:
+				return encode_i(RI, ADD, rd, rd, immediate_6(data));
+			case 0x1:
+				return encode_j(ra, jump_offset(data));
+			case 0x2:
+				return encode_i(RI, ADD, rd, zero, immediate_6(data));
+			case 0x3:
+				if (rd == sp)
+				{
+					// C.ADDI16SP: nzimm[9|4|6|8:7|5]
+					const unsigned_data immediate = mask_data(data, 6, 6) << 4 | mask_data(data, 2, 2) << 5 | mask_data(data, 5, 5) << 6 |
+						mask_data(data, 3, 4) << 7 | sign_extend(mask_data(data, 12, 12), 9);
+					return immediate == 0 ? 0 : encode_i(RI, ADD, sp, sp, immediate);
+				}
+				else
+				{
+					// C.LUI: nzimm[17|16:12]
+					const unsigned_data immediate = immediate_6(data) << 12;
+					return immediate == 0 ? 0 : (immediate & 0xFFFFF000) | rd << 7 | LUI;
+				}
+			case 0x4:
+				switch (mask_data(data, 10, 11))
+				{
+				case 0x0:
+					// shift amounts of 32 and above are reserved on RV32
+					return mask_data(data, 12, 12) ? 0 : encode_i(RI, SRL, rd_compact, rd_compact, mask_data(data, 2, 6));
+				case 0x1:
+					return mask_data(data, 12, 12) ? 0 : encode_i(RI, SRA, rd_compact, rd_compact, INV << 5 | mask_data(data, 2, 6));
+				case 0x2:
+					return encode_i(RI, AND, rd_compact, rd_compact, immediate_6(data));
+				default:
+				{
+					// bit 12 set selects the RV64 word operations
+					if (mask_data(data, 12, 12))
+						return 0;
+					const RegisterName rs2 = compact_register(data, 2);
+					constexpr Funct3 operations[] = { SUB, XOR, OR, AND };
+					const Funct3 funct3 = operations[mask_data(data, 5, 6)];
+					return encode_r(funct3, funct3 == SUB ? INV : NORM, rd_compact, rd_compact, rs2);
+				}
+				}
+			case 0x5:
+				return encode_j(zero, jump_offset(data));
+			case 0x6:
+				return encode_b(BEQ, rd_compact, branch_offset(data));
+			default:
+				return encode_b(BNE, rd_compact, branch_offset(data));
+			}
+		}
+
+		inst_data expand_quadrant_2(const uint16_t data)
+		{
+			const auto rd = static_cast<RegisterName>(mask_data(data, 7, 11));
+			const auto rs2 = static_cast<RegisterName>(mask_data(data, 2, 6));
+
+			switch (mask_data(data, 13, 15))
+			{
+			case 0x0:
+				return mask_data(data, 12, 12) ? 0 : encode_i(RI, SLL, rd, rd, mask_data(data, 2, 6));
+			case 0x2:
+			{
+				// C.LWSP: uimm[5|4:2|7:6]
+				const unsigned_data offset = mask_data(data, 4, 6) << 2 | mask_data(data, 12, 12) << 5 | mask_data(data, 2, 3) << 6;
+				return rd == zero ? 0 : encode_i(LX, LW, rd, sp, offset);
+			}
+			case 0x4:
+				if (!mask_data(data, 12, 12))
+				{
+					// C.JR without rs2, C.MV with it
+					if (rs2 == zero)
+						return rd == zero ? 0 : encode_i(JALR, ADD, zero, rd, 0);
+					return encode_r(ADD, NORM, rd, zero, rs2);
+				}
+				// C.EBREAK, C.JALR, C.ADD
+				if (rs2 == zero)
+					return rd == zero ? 0x00100073 : encode_i(JALR, ADD, ra, rd, 0);
+				return encode_r(ADD, NORM, rd, rd, rs2);
+			case 0x6:
+			{
+				// C.SWSP: uimm[5:2|7:6]
+				const unsigned_data offset = mask_data(data, 9, 12) << 2 | mask_data(data, 7, 8) << 6;
+				return encode_s(sp, rs2, offset);
+			}
+			default:
+				return 0;
+			}
+		}
+	}
+
+	inst_data expand_compressed(const uint16_t instruction_data)
+	{
+		switch (instruction_data & 0x3)
+		{
+		case 0x0:
+			return expand_quadrant_0(instruction_data);
+		case 0x1:
+			return expand_quadrant_1(instruction_data);
+		case 0x2:
+			return expand_quadrant_2(instruction_data);
+		default:
+			return 0;
+		}
+	}
+}
@@ -0,0 +1,14 @@
+#pragma once
+#include "common.h"
+
+namespace RV32IM
+{
+	// RV32C: 16 bit encodings are any whose two low bits are not 0b11
+	inline bool is_compressed(const inst_data instruction_data)
+	{
+		return (instruction_data & 0x3) != 0x3;
+	}
+
+	// returns the equivalent 32 bit RV32I encoding, or 0 for reserved encodings and the floating point forms
+	inst_data expand_compressed(uint16_t instruction_data);
+}
@@ -0,0 +1,247 @@
+#include "compressed_image.h"
+
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+namespace RV32IM
+{
+	namespace
+	{
+		constexpr uint32_t LZ4_FRAME_MAGIC = 0x184D2204;
+		constexpr uint32_t LZ4_UNCOMPRESSED_BLOCK = 0x80000000;
+		constexpr size_t LZ4_MIN_MATCH = 4;
+		// flat images store their memory size in the word at 0x30
+		constexpr size_t MEMORY_SIZE_OFFSET = 0x30;
+
+		// xxHash32 with seed 0, which LZ4 frames use for the header, block and content checksums
+		uint32_t xxhash32(const uint8_t* data, const size_t size)
+		{
+			constexpr uint32_t PRIME1 = 0x9E3779B1;
+			constexpr uint32_t PRIME2 = 0x85EBCA77;
+			constexpr uint32_t PRIME3 = 0xC2B2AE3D;
+			constexpr uint32_t PRIME4 = 0x27D4EB2F;
+			constexpr uint32_t PRIME5 = 0x165667B1;
+			const auto rotate = [](const uint32_t value, const int bits) { return value << bits | value >> (32 - bits); };
+			const auto read_word = [](const uint8_t* bytes)
+				{
+					uint32_t word;
+					memcpy(&word, bytes, sizeof(word));
+					return word;
+				};
+
+			const uint8_t* end = data + size;
+			uint32_t hash;
+			if (size >= 16)
+			{
+				uint32_t lanes[4] = { PRIME1 + PRIME2, PRIME2, 0, 0 - PRIME1 };
+				for (; end - data >= 16; data += 16)
+					for (int lane = 0; lane < 4; lane++)
+						lanes[lane] = rotate(lanes[lane] + read_word(data + lane * 4) * PRIME2, 13) * PRIME1;
+				hash = rotate(lanes[0], 1) + rotate(lanes[1], 7) + rotate(lanes[2], 12) + rotate(lanes[3], 18);
+			}
+			else
+			{
+				hash = PRIME5;
+			}
+			hash += static_cast<uint32_t>(size);
+
+			for (; end - data >= 4; data += 4)
+				hash = rotate(hash + read_word(data) * PRIME3, 17) * PRIME4;
+			for (; data < end; data++)
+				hash = rotate(hash + *data * PRIME5, 11) * PRIME1;
+
+			hash ^= hash >> 15;
+			hash *= PRIME2;
+			hash ^= hash >> 13;
+			hash *= PRIME3;
+			hash ^= hash >> 16;
+			return hash;
+		}
+
+		template <typename T>
+		T read_value(ifstream& file)
+		{
+			T value;
+			file.read(reinterpret_cast<char*>(&value), sizeof(T));
+			if (!file)
+				throw CompressedImageError("Truncated compressed image!");
+			return value;
+		}
+
+		size_t read_length(const uint8_t*& input, const uint8_t* input_end, size_t length)
+		{
+			// a nibble of 15 continues with bytes until one is not 255
+			if (length != 15)
+				return length;
+			uint8_t next;
+			do
+			{
+				if (input >= input_end)
+					throw CompressedImageError("Corrupt LZ4 block!");
+				next = *input++;
+				length += next;
+			} while (next == 255);
+			return length;
+		}
+
+		// decodes one LZ4 block to output + position, matches may reach back into earlier blocks
+		// output must be zeroed past position so runs of zeros can be skipped instead of copied
+		size_t decode_block(const uint8_t* input, const size_t input_size, uint8_t* output, size_t position, const size_t output_size)
+		{
+			const uint8_t* input_end = input + input_size;
+			while (input < input_end)
+			{
+				const uint8_t token = *input++;
+
+				const size_t literal_length = read_length(input, input_end, token >> 4);
+				if (literal_length > static_cast<size_t>(input_end - input) || literal_length > output_size - position)
+					throw CompressedImageError("Corrupt LZ4 block!");
+				memcpy(output + position, input, literal_length);
+				input += literal_length;
+				position += literal_length;
+
+				// the last sequence of a block has literals only
+				if (input >= input_end)
+					break;
+
+				if (input_end - input < 2)
+					throw CompressedImageError("Corrupt LZ4 block!");
+				const size_t offset = input[0] | input[1] << 8;
+				input += 2;
+				const size_t match_length = read_length(input, input_end, token & 0xF) + LZ4_MIN_MATCH;
+				if (offset == 0 || offset > position || match_length > output_size - position)
+					throw CompressedImageError("Corrupt LZ4 block!");
+
+				const uint8_t* match = output + position - offset;
+				if (offset == 1 && *match == 0)
+				{
+					// run of zeros, the destination is already zero
+				}
+				else if (offset >= match_length)
+				{
+					memcpy(output + position, match, match_length);
+				}
+				else
+				{
+					// overlapping match repeats the last offset bytes
+					for (size_t i{ 0 }; i < match_length; i++)
+						output[position + i] = match[i];
+				}
+				position += match_length;
+			}
+			return position;
+		}
+	}
+
+	bool CompressedImageLoader::is_compressed_image(const string& file_path)
+	{
+		ifstream file(file_path, ios::binary);
+		uint32_t magic = 0;
+		file.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+		return file && magic == LZ4_FRAME_MAGIC;
+	}
+
+	ProgramImage CompressedImageLoader::load(const string& file_path)
+	{
+		ifstream file(file_path, ios::binary);
+		if (!file)
+			throw CompressedImageError("Unable to open compressed image!");
+		if (read_value<uint32_t>(file) != LZ4_FRAME_MAGIC)
+			throw CompressedImageError("Not an LZ4 frame!");
+
+		// the header checksum covers the descriptor, from the flags byte up to the checksum itself
+		uint8_t descriptor[10];
+		size_t descriptor_size = 2;
+		const auto flags = descriptor[0] = read_value<uint8_t>(file);
+		const auto block_descriptor = descriptor[1] = read_value<uint8_t>(file);
+		if ((flags >> 6) != 0b01)
+			throw CompressedImageError("Unsupported LZ4 frame version!");
+		if (flags & 0b1)
+			throw CompressedImageError("LZ4 dictionaries are not supported!");
+		const bool block_checksums = flags & 0b10000;
+		const bool content_size_present = flags & 0b1000;
+		const bool content_checksum = flags & 0b100;
+		const size_t max_block_size = static_cast<size_t>(1) << (8 + 2 * ((block_descriptor >> 4) & 0b111));
+
+		uint64_t content_size = 0;
+		if (content_size_present)
+		{
+			content_size = read_value<uint64_t>(file);
+			memcpy(descriptor + descriptor_size, &content_size, sizeof(content_size));
+			descriptor_size += sizeof(content_size);
+		}
+		if (read_value<uint8_t>(file) != (xxhash32(descriptor, descriptor_size) >> 8 & 0xFF))
+			throw CompressedImageError("LZ4 frame header checksum mismatch!");
+
+		ProgramImage image{ nullptr, 0, 0, {} };
+		vector<uint8_t> block(max_block_size);
+		vector<uint8_t> first_block;
+		size_t position = 0;
+
+		while (true)
+		{
+			const auto block_size = read_value<uint32_t>(file);
+			if (block_size == 0)
+				break;
+
+			const size_t data_size = block_size & ~LZ4_UNCOMPRESSED_BLOCK;
+			if (data_size > max_block_size)
+				throw CompressedImageError("LZ4 block exceeds the frame's block size!");
+			file.read(reinterpret_cast<char*>(block.data()), static_cast<streamsize>(data_size));
+			if (!file)
+				throw CompressedImageError("Truncated compressed image!");
+			if (block_checksums && read_value<uint32_t>(file) != xxhash32(block.data(), data_size))
+				throw CompressedImageError("LZ4 block checksum mismatch!");
+
+			// the memory size is only known once the first block is decoded
+			uint8_t* output = image.memory.get();
+			size_t output_size = image.memory_size;
+			if (!output)
+			{
+				first_block = vector<uint8_t>(max_block_size, 0);
+				output = first_block.data();
+				output_size = first_block.size();
+			}
+
+			if (block_size & LZ4_UNCOMPRESSED_BLOCK)
+			{
+				if (data_size > output_size - position)
+					throw CompressedImageError("Compressed image is larger than its memory size!");
+				memcpy(output + position, block.data(), data_size);
+				position += data_size;
+			}
+			else
+			{
+				position = decode_block(block.data(), data_size, output, position, output_size);
+			}
+
+			if (!image.memory)
+			{
+				if (position < MEMORY_SIZE_OFFSET + sizeof(uint32_t))
+					throw CompressedImageError("First block is too small to hold the memory size!");
+				uint32_t memory_size;
+				memcpy(&memory_size, first_block.data() + MEMORY_SIZE_OFFSET, sizeof(memory_size));
+				if (memory_size == 0 || (memory_size & (memory_size - 1)) != 0)
+					throw CompressedImageError("Memory size must be a power of 2!");
+				if (content_size_present && content_size > memory_size)
+					throw CompressedImageError("Compressed image is larger than its memory size!");
+				if (position > memory_size)
+					throw CompressedImageError("Compressed image is larger than its memory size!");
+
+				image.memory = shared_ptr<uint8_t[]>(new uint8_t[memory_size]);
+				image.memory_size = memory_size;
+				memcpy(image.memory.get(), first_block.data(), position);
+				memset(image.memory.get() + position, 0, memory_size - position);
+				first_block = {};
+			}
+		}
+		if (!image.memory)
+			throw CompressedImageError("Compressed image is empty!");
+		if (content_size_present && content_size != position)
+			throw CompressedImageError("LZ4 content size mismatch!");
+		if (content_checksum && read_value<uint32_t>(file) != xxhash32(image.memory.get(), position))
+			throw CompressedImageError("LZ4 content checksum mismatch!");
+		return image;
+	}
+}
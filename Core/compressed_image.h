@@ -0,0 +1,31 @@
+#pragma once
+#include <exception>
+#include <string>
+
+#include "common.h"
+#include "program_image.h"
+
+namespace RV32IM
+{
+	// flat .bin images stored as an LZ4 frame (as written by `lz4 -9 image.bin`)
+	class CompressedImageLoader
+	{
+	public:
+		static bool is_compressed_image(const string& file_path);
+		static ProgramImage load(const string& file_path);
+	};
+
+	class CompressedImageError : public exception
+	{
+	public:
+		explicit CompressedImageError(string message) : message(std::move(message)) {}
+
+		const char* what() const noexcept override
+		{
+			return message.c_str();
+		}
+
+	private:
+		string message;
+	};
+}
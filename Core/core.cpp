@@ -8,7 +8,7 @@ namespace RV32IM
 	{
 	}*/
 
-	Core::Core(const int time_per_clock, const int video_width, const int video_height) :
+	Core::Core(const int time_per_clock, const int video_width, const int video_height, const PredictorConfig& predictor_config, const unsigned_data hart_id) :
 		fetch(new Stage::Fetch(this)),
 		decode(new Stage::Decode(this)),
 		execute(new Stage::Execute(this)),
@@ -16,30 +16,58 @@ namespace RV32IM
 		write_back(new Stage::WriteBack(this)),
 		register_file(new RegisterFile()),
 		memory(new UnifiedMemory(0x100)),
-		branch(new BranchPrediction(0x100)),
-		video_interface(new VideoInterface(memory, video_width, video_height)),
+		hart_id(hart_id),
+		branch(make_branch_predictor(predictor_config)),
+		target_buffer(new BranchTargetBuffer(predictor_config.btb_entries)),
+		return_stack(new ReturnAddressStack(predictor_config.ras_depth)),
+		predictor_config(predictor_config),
+		table_backing(PageBacking::NORMAL),
+		counters(new PerformanceCounters()),
+		lockstep(nullptr),
+		stop_info(),
+		pending_stop(),
+		draining(false),
+		skip_breakpoint(false),
+		video_interface(new VideoInterface(memory, video_width, video_height, statistics)),
 		video_width(video_width),
 		video_height(video_height),
 		memory_size(0x100),
+		page_backing(PageBacking::NORMAL),
 		block_irq(false),
 		clock_start(),
 		processing_start(),
 		end(),
 		desired_clock_time(time_per_clock),
-		halt_clock(true),
-		timer_counter(0),
-		halt_counter(true),
-		halt_uart(true)
+		run_state(RunState::PAUSED),
+		until_pc(0),
+		parked_workers(0),
+		workers_started(false),
+		timer_counter(0)
 	{
 	}
 
 	Core::~Core()
 	{
 		stop_clock();
+		{
+			lock_guard lock(run_mutex);
+			run_state = RunState::EXITING;
+		}
+		run_changed.notify_all();
+		for (thread* worker : { &clock_thread, &counter_thread, &uart_tx_thread })
+			if (worker->joinable())
+				worker->join();
 	}
 
 	void Core::clock() const
 	{
+		// a cache miss freezes every stage until the line arrives
+		if (caches && caches->stalled())
+		{
+			counters->count_cycle();
+			return;
+		}
+
         write_back->run();
         memory_stage->run();
         execute->run();
@@ -53,17 +81,117 @@ namespace RV32IM
         write_back->clock();
 
         register_file->clock();
+        counters->count_cycle();
+	}
+
+	bool Core::clock_checked()
+	{
+		if (caches && caches->stalled())
+		{
+			counters->count_cycle();
+			return false;
+		}
+
+		// a load or store about to enter the memory stage is checked before it touches memory
+		const Instruction access = execute->reg_instruction.read();
+		bool watch_hit = false;
+		if (debug_points && pending_stop.reason != StopReason::WATCHPOINT &&
+			(access.opcode == Opcodes::LX || access.opcode == Opcodes::SX || access.opcode == Opcodes::AMO))
+		{
+			const unsigned_data address = execute->reg_alu.read();
+			WatchType type = access.opcode == Opcodes::LX ? WATCH_READ : WATCH_WRITE;
+			// an AMO both reads and writes its word
+			if (access.opcode == Opcodes::AMO)
+				type = access.inst >> 27 == LR_W ? WATCH_READ : access.inst >> 27 == SC_W ? WATCH_WRITE : WATCH_ACCESS;
+			if (debug_points->is_watched(address, 1u << (access.funct3 & 0x3), type))
+			{
+				watch_hit = true;
+				pending_stop = { StopReason::WATCHPOINT, execute->reg_PC.read() + access.length, address, type };
+			}
+		}
+
+		write_back->run();
+		memory_stage->run();
+		execute->run();
+		decode->run();
+
+		if (watch_hit)
+		{
+			// squash everything younger than the access so it is the last instruction to complete,
+			// their branch predictor updates are harmless since they will be fetched again
+			execute->reg_instruction = InstructionNOP();
+			decode->reg_instruction = InstructionNOP();
+			fetch->squash(2);
+			fetch->stall(false);
+			fetch->notify_jump(true, pending_stop.pc);
+			draining = true;
+		}
+		else if (!draining)
+		{
+			const unsigned_data next_pc = fetch->get_next_PC();
+			if (skip_breakpoint && next_pc == stop_info.pc)
+				skip_breakpoint = false;
+			else if ((debug_points && debug_points->is_breakpoint(next_pc)) || (run_state == RunState::RUN_UNTIL && next_pc == until_pc))
+			{
+				draining = true;
+				pending_stop = { debug_points && debug_points->is_breakpoint(next_pc) ? StopReason::BREAKPOINT : StopReason::RUN_UNTIL, next_pc, 0, WATCH_ACCESS };
+			}
+		}
+		skip_breakpoint = false;
+
+		if (draining)
+			fetch->hold();
+		else
+			fetch->run();
+
+		fetch->clock();
+		decode->clock();
+		execute->clock();
+		memory_stage->clock();
+		write_back->clock();
+
+		register_file->clock();
+		counters->count_cycle();
+
+		if (!draining || !is_pipeline_empty())
+			return false;
+
+		draining = false;
+		const StopReason reason = pending_stop.reason;
+		pending_stop.reason = StopReason::NONE;
+		// the breakpoint was fetched on a path an older branch then squashed
+		if ((reason == StopReason::BREAKPOINT || reason == StopReason::RUN_UNTIL) && fetch->get_next_PC() != pending_stop.pc)
+			return false;
+
+		stop_info = pending_stop;
+		stop_info.reason = reason;
+		stop_info.pc = fetch->get_next_PC();
+		skip_breakpoint = true;
+		return true;
+	}
+
+	bool Core::is_pipeline_empty() const
+	{
+		return fetch->reg_instruction.read().bubble && decode->reg_instruction.read().bubble && execute->reg_instruction.read().bubble &&
+			memory_stage->reg_instruction.read().bubble && decode->irq_counter == 0;
 	}
 
 	void Core::get_irq_free() const
 	{
 #ifndef _DEBUG
+		// only the running clock can finish the handler, so give up once paused instead of blocking the pause
 		if (memory->read_byte(irq_en) == 1)
-			while (memory->read_byte(irq_handle) != 1) {}
+			while (memory->read_byte(irq_handle) != 1 && is_running(run_state)) {}
 #endif
 	}
 
-	void Core::load_memory_contents(const shared_ptr<uint8_t[]>& new_memory, const size_t new_memory_size)
+	void Core::load_memory_contents(const shared_ptr<uint8_t[]>& new_memory, const size_t new_memory_size, const unsigned_data entry_point)
+	{
+		const auto new_unified_memory = make_shared<UnifiedMemory>(new_memory, new_memory_size, page_backing);
+		attach_memory(new_unified_memory, new_memory_size, entry_point);
+	}
+
+	void Core::attach_memory(const shared_ptr<UnifiedMemory>& shared_memory, const size_t new_memory_size, const unsigned_data entry_point)
 	{
 		bool restart_clock = false;
 		if (is_clock_running())
@@ -72,14 +200,38 @@ namespace RV32IM
 		stop_clock();
 		memory_size = new_memory_size;
 		update_offsets(memory_size);
-		memory = make_shared<UnifiedMemory>(memory_size);
-        memory->load_memory_contents(new_memory);
+		memory = shared_memory;
+		// the reset below leaves the tables cold anyway, so rebuilding them costs no training
+		if (table_backing != page_backing)
+		{
+			table_backing = page_backing;
+			branch = make_branch_predictor(predictor_config, table_backing);
+			target_buffer = make_unique<BranchTargetBuffer>(predictor_config.btb_entries, table_backing);
+		}
 		reset();
+		fetch->set_entry_point(entry_point);
+		symbols.clear();
 
 		if (restart_clock)
 			start_clock();
 	}
 
+	void Core::load_program_image(ProgramImage image)
+	{
+		load_memory_contents(image.memory, image.memory_size, image.entry_point);
+		symbols = std::move(image.symbols);
+	}
+
+	void Core::load_elf(const string& file_path)
+	{
+		load_program_image(ElfLoader::load(file_path));
+	}
+
+	void Core::load_compressed_image(const string& file_path)
+	{
+		load_program_image(CompressedImageLoader::load(file_path));
+	}
+
 	void Core::set_desired_clock_time(const int time_per_clock)
 	{
 		desired_clock_time = time_per_clock;
@@ -95,6 +247,16 @@ namespace RV32IM
 		return video_interface->get_video_memory();
 	}
 
+	void Core::set_page_backing(const PageBacking backing)
+	{
+		page_backing = backing;
+	}
+
+	PageBacking Core::get_page_backing() const
+	{
+		return memory->get_page_backing();
+	}
+
 	size_t Core::get_memory_size() const
 	{
 		return memory_size;
@@ -112,150 +274,265 @@ namespace RV32IM
 
 	void Core::start_clock()
 	{
-		if (halt_counter && halt_clock)
+		begin_run(RunState::RUNNING, 0);
+	}
+
+	void Core::stop_clock()
+	{
+		unique_lock lock(run_mutex);
+		if (is_running(run_state))
+			run_state = RunState::PAUSED;
+		run_changed.notify_all();
+		// a run-until can pause on its own, so always wait for the workers before touching the pipeline
+		if (workers_started)
+			run_changed.wait(lock, [this] { return parked_workers == NUM_WORKERS; });
+		lock.unlock();
+		video_interface->stop_drawing();
+	}
+
+	void Core::step_clock(const uint64_t cycles)
+	{
+		if (settle_paused())
 		{
-			halt_counter = false;
-			halt_clock = false;
+			// a finished run-until may have left the draw thread going
+			video_interface->stop_drawing();
+			for (uint64_t i{ 0 }; i < cycles; i++)
+				clock();
+			statistics.publish(*counters);
+			if (owns_devices())
+			{
+				poll_uart();
+				video_interface->draw_frame();
+			}
+		}
+	}
 
+	void Core::run_until(const unsigned_data pc)
+	{
+		begin_run(RunState::RUN_UNTIL, pc);
+	}
+
+	void Core::begin_run(const RunState state, const unsigned_data pc)
+	{
+		{
+			unique_lock lock(run_mutex);
+			if (!settle_paused(lock))
+				return;
+			// claiming the transition under the lock keeps two callers from both starting the core
+			RunState expected = RunState::PAUSED;
+			if (!run_state.compare_exchange_strong(expected, state))
+				return;
+			until_pc = pc;
+		}
+		start_workers();
+		if (owns_devices())
 			video_interface->start_drawing();
+		run_changed.notify_all();
+	}
 
-			counter_thread = thread([this]()
-				{
-					while (!halt_counter)
-					{
-						this_thread::sleep_for(chrono::milliseconds(1));
-						timer_counter++;
-						memory->write_byte(timer_in, timer_counter);
-						if (timer_counter % 32 == 0)
-							notify_timer();
-					}
-				});
+	bool Core::settle_paused()
+	{
+		unique_lock lock(run_mutex);
+		return settle_paused(lock);
+	}
 
-			clock_thread = thread([this]()
-				{
-					while (!halt_clock)
-					{
-						clock_start = chrono::steady_clock::now();
+	bool Core::settle_paused(unique_lock<mutex>& lock)
+	{
+		// a run-until or breakpoint pauses from the clock thread, which may still be finishing its batch
+		if (workers_started)
+			run_changed.wait(lock, [this] { return run_state != RunState::PAUSED || parked_workers == NUM_WORKERS; });
+		return run_state == RunState::PAUSED;
+	}
 
-						if (desired_clock_time != 0)
-						{
-							this_thread::sleep_for(chrono::nanoseconds(desired_clock_time * 512 * 512 - average_processing.get_average() * 512 * 512));
-						}
-						for (size_t j{ 0 }; j < 512; j++)
-						{
-							processing_start = chrono::steady_clock::now();
-							for (size_t i{ 0 }; i < 512; i++)
-								clock();
+	void Core::start_workers()
+	{
+		// created once and parked while paused, so pausing and stepping never create threads
+		if (workers_started)
+			return;
+		workers_started = true;
+		clock_thread = thread(&Core::clock_loop, this);
+		counter_thread = thread(&Core::counter_loop, this);
+		uart_tx_thread = thread(&Core::uart_loop, this);
+	}
 
-							end = chrono::steady_clock::now();
+	bool Core::wait_while_paused()
+	{
+		unique_lock lock(run_mutex);
+		parked_workers++;
+		run_changed.notify_all();
+		run_changed.wait(lock, [this] { return run_state != RunState::PAUSED; });
+		parked_workers--;
+		return run_state != RunState::EXITING;
+	}
 
-							average_processing.add_sample((end - processing_start).count() >> 9);  // NOLINT(clang-diagnostic-shorten-64-to-32, bugprone-narrowing-conversions, cppcoreguidelines-narrowing-conversions)
-						}
-						if (memory->read_byte(irq_handle) == 1)
+	void Core::wait_until_paused()
+	{
+		// the device workers of secondary harts sleep through the run instead of racing hart 0 for the shared devices
+		unique_lock lock(run_mutex);
+		run_changed.wait(lock, [this] { return !is_running(run_state); });
+	}
+
+	bool Core::owns_devices() const
+	{
+		return hart_id == 0;
+	}
+
+	bool Core::is_running(const RunState state)
+	{
+		return state == RunState::RUNNING || state == RunState::RUN_UNTIL;
+	}
+
+	void Core::clock_loop()
+	{
+		while (wait_while_paused())
+		{
+			while (is_running(run_state))
+			{
+				clock_start = chrono::steady_clock::now();
+
+				if (desired_clock_time != 0)
+				{
+					unique_lock lock(run_mutex);
+					run_changed.wait_for(lock, chrono::nanoseconds(desired_clock_time * 512 * 512 - average_processing.get_average() * 512 * 512),
+						[this] { return !is_running(run_state); });
+				}
+				for (size_t j{ 0 }; j < 512; j++)
+				{
+					// checking once per batch keeps the hot loop free of atomics while still pausing promptly
+					const RunState state = run_state.load(memory_order_acquire);
+					if (!is_running(state))
+						break;
+
+					processing_start = chrono::steady_clock::now();
+					if (state == RunState::RUN_UNTIL || debug_points)
+					{
+						for (size_t i{ 0 }; i < 512; i++)
 						{
-							block_irq = false;
+							if (clock_checked())
+							{
+								RunState expected = state;
+								{
+									lock_guard lock(run_mutex);
+									run_state.compare_exchange_strong(expected, RunState::PAUSED);
+								}
+								run_changed.notify_all();
+								break;
+							}
 						}
-						average_clock.add_sample((end - clock_start).count() >> 18);  // NOLINT(clang-diagnostic-shorten-64-to-32, bugprone-narrowing-conversions, cppcoreguidelines-narrowing-conversions)
 					}
-				});
+					else
+					{
+						for (size_t i{ 0 }; i < 512; i++)
+							clock();
+					}
 
-			start_uart_tx();
+					end = chrono::steady_clock::now();
+
+					average_processing.add_sample((end - processing_start).count() >> 9);  // NOLINT(clang-diagnostic-shorten-64-to-32, bugprone-narrowing-conversions, cppcoreguidelines-narrowing-conversions)
+					statistics.publish(*counters);
+				}
+				if (memory->read_byte(irq_handle) == 1)
+				{
+					block_irq = false;
+				}
+				average_clock.add_sample((end - clock_start).count() >> 18);  // NOLINT(clang-diagnostic-shorten-64-to-32, bugprone-narrowing-conversions, cppcoreguidelines-narrowing-conversions)
+				// the averages belong to this thread, readers only see the published copies
+				statistics.publish_timing(average_clock.get_average(), average_processing.get_average());
+			}
 		}
 	}
 
-	void Core::stop_clock()
+	void Core::counter_loop()
 	{
-		if (!halt_counter && !halt_clock)
+		while (wait_while_paused())
 		{
-			video_interface->stop_drawing();
-
-			halt_counter = true;
-			if (counter_thread.joinable())
-				counter_thread.join();
-
-			halt_clock = true;
-			if (clock_thread.joinable())
-				clock_thread.join();
-
-			stop_uart_tx();
+			if (!owns_devices())
+				wait_until_paused();
+			while (is_running(run_state))
+			{
+				this_thread::sleep_for(chrono::milliseconds(1));
+				timer_counter++;
+				memory->write_byte(timer_in, timer_counter);
+				if (timer_counter % 32 == 0)
+					notify_timer();
+			}
 		}
 	}
 
-	void Core::step_clock()
+	void Core::uart_loop()
 	{
-		if (halt_counter && halt_clock)
+		while (wait_while_paused())
 		{
-			clock();
-			video_interface->start_drawing();
-			video_interface->stop_drawing();
-			start_uart_tx();
-			stop_uart_tx();
+			if (!owns_devices())
+				wait_until_paused();
+			while (is_running(run_state))
+				poll_uart();
 		}
 	}
 
 	void Core::reset()
 	{
 		stop_clock();
-		fetch = make_unique<Stage::Fetch>(this);
-		decode = make_unique < Stage::Decode>(this);
-		execute = make_unique<Stage::Execute>(this);
-		memory_stage = make_unique<Stage::Memory>(this);
-		write_back = make_unique<Stage::WriteBack>(this);
-		register_file = make_unique<RegisterFile>();
-		branch = make_unique<BranchPrediction>(memory_size);
-		video_interface = make_unique<VideoInterface>(memory, video_width, video_height);
+		// everything below was sized in the constructor, so it is cleared in place instead of reallocated
+		fetch->reset();
+		decode->reset();
+		execute->reset();
+		memory_stage->reset();
+		write_back->reset();
+		register_file->reset();
+		branch->reset();
+		target_buffer->reset();
+		return_stack->reset();
+		counters->reset();
+		if (profiler)
+			profiler->reset();
+		if (caches)
+			caches->reset();
+		statistics.reset();
+		video_interface->reset(memory);
 		timer_counter = 0;
 		block_irq = false;
-		uart_data = "";
+		stop_info = {};
+		pending_stop = {};
+		draining = false;
+		skip_breakpoint = false;
+		uart_data.clear();
 	}
 
-	void Core::start_uart_tx()
+	void Core::poll_uart()
 	{
-		halt_uart = false;
-		uart_tx_thread = thread([this]()
+		if (memory->read_byte(data_ready) == 1)
+		{
+			size_t pos;
+			const auto tx_data = static_cast<char>(memory->read_byte(uart_tx));
+			switch (tx_data)
 			{
-				while (!halt_uart)
+			case 2:
+				uart_data = "";
+				break;
+			case '\r':
+				pos = uart_data.rfind('\n');
+
+				// If the character is found, create a substring excluding the trailing characters
+				if (pos != std::string::npos) {
+					uart_data = uart_data.substr(0, pos + 1);
+				}
+				else
 				{
-					if (memory->read_byte(data_ready) == 1)
-					{
-						size_t pos;
-						const auto tx_data = static_cast<char>(memory->read_byte(uart_tx));
-						switch (tx_data)
-						{
-						case 2:
-							uart_data = "";
-							break;
-						case '\r':
-							pos = uart_data.rfind('\n');
-
-							// If the character is found, create a substring excluding the trailing characters
-							if (pos != std::string::npos) {
-								uart_data = uart_data.substr(0, pos + 1);
-							}
-							else
-							{
-								uart_data = "";
-							}
-							break;
-						case '\b':
-							if (uart_data.length() > 0)
-								uart_data.pop_back();
-							break;
-						default:
-							uart_data += tx_data;
-							break;
-						}
-						memory->write_byte(data_ready, 0);
-					}
+					uart_data = "";
 				}
-			});
-	}
-
-	void Core::stop_uart_tx()
-	{
-		halt_uart = true;
-		if (uart_tx_thread.joinable())
-			uart_tx_thread.join();
+				break;
+			case '\b':
+				if (uart_data.length() > 0)
+					uart_data.pop_back();
+				break;
+			default:
+				uart_data += tx_data;
+				break;
+			}
+			memory->write_byte(data_ready, 0);
+			statistics.count_uart_byte();
+		}
 	}
 
 	void Core::notify_keypress(const unsigned char input)
@@ -283,7 +560,17 @@ namespace RV32IM
 
 	bool Core::is_clock_running() const
 	{
-		return !halt_clock;
+		return is_running(run_state);
+	}
+
+	RunState Core::get_run_state() const
+	{
+		return run_state;
+	}
+
+	unsigned_data Core::get_hart_id() const
+	{
+		return hart_id;
 	}
 
 	unsigned_data Core::get_current_address() const
@@ -298,12 +585,12 @@ namespace RV32IM
 
 	int Core::get_average_clock_time() const
 	{
-		return average_clock.get_average();
+		return statistics.get_clock_time();
 	}
 
 	int Core::get_average_processing_time() const
 	{
-		return average_processing.get_average();
+		return statistics.get_processing_time();
 	}
 
 	bool Core::get_irq() const
@@ -316,6 +603,231 @@ namespace RV32IM
 		return uart_data;
 	}
 
+	const PerformanceCounters& Core::get_performance_counters() const
+	{
+		return *counters;
+	}
+
+	const BranchPredictor& Core::get_branch_predictor() const
+	{
+		return *branch;
+	}
+
+	const SymbolTable& Core::get_symbols() const
+	{
+		return symbols;
+	}
+
+	void Core::enable_profiler(const bool enable)
+	{
+		if (enable && !profiler)
+			profiler = make_unique<Profiler>();
+		else if (!enable)
+			profiler.reset();
+	}
+
+	Profiler* Core::get_profiler() const
+	{
+		return profiler.get();
+	}
+
+	StatsSnapshot Core::get_stats_snapshot() const
+	{
+		return statistics.snapshot();
+	}
+
+	const Statistics& Core::get_statistics() const
+	{
+		return statistics;
+	}
+
+	void Core::start_stats_export(const string& file_path, const StatsFormat format, const chrono::milliseconds period, const string& instance)
+	{
+		// the exporter only reads atomics, so the clock can keep running
+		stats_exporter.reset();
+		stats_exporter = make_unique<StatsExporter>(statistics, file_path, format, period, instance);
+	}
+
+	void Core::stop_stats_export()
+	{
+		stats_exporter.reset();
+	}
+
+	void Core::start_bbv(const string& file_path, const uint64_t interval)
+	{
+		const bool restart_clock = is_clock_running();
+		stop_clock();
+		bbv = make_unique<BbvCollector>(file_path, interval);
+		if (restart_clock)
+			start_clock();
+	}
+
+	void Core::stop_bbv()
+	{
+		const bool restart_clock = is_clock_running();
+		stop_clock();
+		// destroying the collector writes the partial last interval
+		bbv.reset();
+		if (restart_clock)
+			start_clock();
+	}
+
+	void Core::enable_caches(const CacheHierarchyConfig& config)
+	{
+		const bool restart_clock = is_clock_running();
+		stop_clock();
+		caches = make_unique<CacheHierarchy>(config);
+		if (restart_clock)
+			start_clock();
+	}
+
+	void Core::disable_caches()
+	{
+		const bool restart_clock = is_clock_running();
+		stop_clock();
+		caches.reset();
+		if (restart_clock)
+			start_clock();
+	}
+
+	const CacheHierarchy* Core::get_caches() const
+	{
+		return caches.get();
+	}
+
+	void Core::start_trace(const string& file_path)
+	{
+		const bool restart_clock = is_clock_running();
+		stop_clock();
+		trace_writer = make_unique<TraceWriter>(file_path);
+		if (restart_clock)
+			start_clock();
+	}
+
+	void Core::stop_trace()
+	{
+		const bool restart_clock = is_clock_running();
+		stop_clock();
+		const unique_ptr<TraceWriter> writer = std::move(trace_writer);
+		if (restart_clock)
+			start_clock();
+		// reports a failed disk write, destroying the writer afterwards joins its thread
+		if (writer)
+			writer->flush();
+	}
+
+	RunState Core::pause_for_update()
+	{
+		const RunState previous_state = run_state;
+		stop_clock();
+		return previous_state;
+	}
+
+	void Core::resume_after_update(const RunState previous_state)
+	{
+		if (previous_state == RunState::RUNNING)
+			start_clock();
+		else if (previous_state == RunState::RUN_UNTIL)
+			run_until(until_pc);
+	}
+
+	void Core::add_breakpoint(const unsigned_data pc)
+	{
+		const RunState previous_state = pause_for_update();
+		if (!debug_points)
+			debug_points = make_unique<DebugPoints>();
+		debug_points->add_breakpoint(pc);
+		resume_after_update(previous_state);
+	}
+
+	bool Core::remove_breakpoint(const unsigned_data pc)
+	{
+		const RunState previous_state = pause_for_update();
+		const bool removed = debug_points && debug_points->remove_breakpoint(pc);
+		// dropping the last debug point puts the clock back on the unchecked path
+		if (debug_points && debug_points->empty())
+			debug_points.reset();
+		resume_after_update(previous_state);
+		return removed;
+	}
+
+	void Core::add_watchpoint(const unsigned_data address, const unsigned_data size, const WatchType type)
+	{
+		const RunState previous_state = pause_for_update();
+		if (!debug_points)
+			debug_points = make_unique<DebugPoints>();
+		debug_points->add_watchpoint(address, size, type);
+		resume_after_update(previous_state);
+	}
+
+	bool Core::remove_watchpoint(const unsigned_data address, const unsigned_data size, const WatchType type)
+	{
+		const RunState previous_state = pause_for_update();
+		const bool removed = debug_points && debug_points->remove_watchpoint(address, size, type);
+		if (debug_points && debug_points->empty())
+			debug_points.reset();
+		resume_after_update(previous_state);
+		return removed;
+	}
+
+	void Core::clear_debug_points()
+	{
+		const RunState previous_state = pause_for_update();
+		debug_points.reset();
+		resume_after_update(previous_state);
+	}
+
+	void Core::drain()
+	{
+		if (!settle_paused() || is_pipeline_empty())
+			return;
+		if (!draining)
+		{
+			draining = true;
+			pending_stop = { StopReason::INTERRUPT, 0, 0, WATCH_ACCESS };
+		}
+		while (!clock_checked()) {}
+	}
+
+	void Core::step_instruction()
+	{
+		if (!settle_paused())
+			return;
+		drain();
+		// the pipeline is empty, so fetching once puts exactly the next instruction in flight
+		clock();
+		draining = true;
+		pending_stop = { StopReason::STEP, 0, 0, WATCH_ACCESS };
+		while (!clock_checked()) {}
+	}
+
+	void Core::halt()
+	{
+		stop_clock();
+		drain();
+	}
+
+	void Core::set_register(const RegisterName reg, const unsigned_data value)
+	{
+		if (reg != zero)
+			register_file->set(reg, value);
+	}
+
+	void Core::set_pc(const unsigned_data pc)
+	{
+		fetch->set_entry_point(pc);
+	}
+
+	const DebugPoints* Core::get_debug_points() const
+	{
+		return debug_points.get();
+	}
+
+	const StopInfo& Core::get_stop_info() const
+	{
+		return stop_info;
+	}
+
 	void Core::interrupt()
 	{
 		if (memory->read_byte(irq_handle) == 1)
@@ -327,6 +839,7 @@ namespace RV32IM
         {
             block_irq = true;
             decode->irq();
+            statistics.count_irq();
         }
 	}
 }
@@ -1,16 +1,30 @@
 #pragma once
 
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <mutex>
 #include <thread>
 #include <string>
 
+#include "bbv.h"
 #include "branch.h"
+#include "branch_target.h"
+#include "cache.h"
+#include "compressed_image.h"
+#include "debug_points.h"
 #include "decode.h"
+#include "elf_loader.h"
 #include "execute.h"
 #include "fetch.h"
+#include "lockstep.h"
 #include "memory.h"
 #include "moving_average.h"
+#include "performance_counters.h"
+#include "profiler.h"
 #include "register_file.h"
+#include "stats.h"
+#include "trace.h"
 #include "unified_memory.h"
 #include "video_control.h"
 #include "write_back.h"
@@ -19,7 +33,13 @@ namespace RV32IM
 {
 	class RegisterFile;
 	class UnifiedMemory;
-	class BranchPrediction;
+	class BranchPredictor;
+
+	// PAUSED parks the clock, timer and UART threads; RUN_UNTIL runs like RUNNING but pauses once fetch reaches a PC
+	enum class RunState : uint8_t
+	{
+		PAUSED, RUNNING, RUN_UNTIL, EXITING
+	};
 
 	class Core
 	{
@@ -29,14 +49,28 @@ namespace RV32IM
 		friend class Stage::Execute;
 		friend class Stage::Memory;
 		friend class Stage::WriteBack;
+		friend class LockstepChecker;
+		friend class SampledSimulation;
+		friend class System;
 
 		Core();
 		// explicit Core(size_t memory_size);
-		Core(int time_per_clock, int video_width, int video_height);
+		// hart 0 owns the timer, UART and video, other harts only run the pipeline, see System
+		Core(int time_per_clock, int video_width, int video_height, const PredictorConfig& predictor_config = {}, unsigned_data hart_id = 0);
 		~Core();
 
-		void load_memory_contents(const shared_ptr<uint8_t[]>& new_memory, size_t new_memory_size);
+		void load_memory_contents(const shared_ptr<uint8_t[]>& new_memory, size_t new_memory_size, unsigned_data entry_point = 0);
+		// runs from memory that other harts may share instead of a private copy
+		void attach_memory(const shared_ptr<UnifiedMemory>& shared_memory, size_t new_memory_size, unsigned_data entry_point = 0);
+		void load_program_image(ProgramImage image);
+		void load_elf(const string& file_path);
+		void load_compressed_image(const string& file_path);
 		void set_desired_clock_time(int time_per_clock);
+		// applies from the next load_memory_contents, which then copies the image into memory of that backing
+		// and rebuilds the predictor tables with it
+		void set_page_backing(PageBacking backing);
+		// what the host granted for the current guest memory
+		[[nodiscard]] PageBacking get_page_backing() const;
 
 		[[nodiscard]] shared_ptr<uint8_t[]>& get_memory_ptr() const;
 		[[nodiscard]] shared_ptr<uint8_t[]>& get_video_memory() const;
@@ -45,8 +79,11 @@ namespace RV32IM
 		[[nodiscard]] int get_video_height() const;
 
 		void start_clock();
+		// returns once every worker thread is parked, so the core can be inspected or stepped safely
 		void stop_clock();
-		void step_clock();
+		// runs synchronously on the calling thread while paused, then services the UART and draws a frame once
+		void step_clock(uint64_t cycles = 1);
+		void run_until(unsigned_data pc);
 		void reset();
 
 		void notify_keypress(unsigned char input);
@@ -54,19 +91,84 @@ namespace RV32IM
 		void notify_timer();
 
 		[[nodiscard]] bool is_clock_running() const;
+		[[nodiscard]] RunState get_run_state() const;
+		[[nodiscard]] unsigned_data get_hart_id() const;
 		[[nodiscard]] unsigned_data get_current_address() const;
 		[[nodiscard]] array<unsigned_data, RegisterFile::NUM_REGISTERS>& get_registers() const;
 		[[nodiscard]] int get_average_clock_time() const;
 		[[nodiscard]] int get_average_processing_time() const;
 		[[nodiscard]] bool get_irq() const;
 		[[nodiscard]] string get_uart_data() const;
+		[[nodiscard]] const PerformanceCounters& get_performance_counters() const;
+		// safe to call from any thread while the clock runs, unlike get_performance_counters
+		[[nodiscard]] StatsSnapshot get_stats_snapshot() const;
+		[[nodiscard]] const Statistics& get_statistics() const;
+		[[nodiscard]] const BranchPredictor& get_branch_predictor() const;
+
+		[[nodiscard]] const SymbolTable& get_symbols() const;
+
+		void enable_profiler(bool enable);
+		[[nodiscard]] Profiler* get_profiler() const;
+
+		void start_trace(const string& file_path);
+		// throws TraceError if part of the trace could not be written
+		void stop_trace();
+
+		// periodic Prometheus or JSON lines snapshots of the statistics, throws StatsError if the file cannot be opened
+		void start_stats_export(const string& file_path, StatsFormat format, chrono::milliseconds period = chrono::milliseconds(1000),
+			const string& instance = "");
+		void stop_stats_export();
+
+		// basic block vectors for SimPoint, one line per interval of retired instructions, throws BbvError if the file cannot be opened
+		void start_bbv(const string& file_path, uint64_t interval = BbvCollector::DEFAULT_INTERVAL);
+		void stop_bbv();
+
+		// off by default, memory then has no latency at all; enabling or disabling starts with cold caches
+		void enable_caches(const CacheHierarchyConfig& config);
+		void disable_caches();
+		[[nodiscard]] const CacheHierarchy* get_caches() const;
+
+		// the clock only takes the checked path while any breakpoint or watchpoint is set
+		void add_breakpoint(unsigned_data pc);
+		bool remove_breakpoint(unsigned_data pc);
+		void add_watchpoint(unsigned_data address, unsigned_data size, WatchType type);
+		bool remove_watchpoint(unsigned_data address, unsigned_data size, WatchType type);
+		void clear_debug_points();
+		[[nodiscard]] const DebugPoints* get_debug_points() const;
+		[[nodiscard]] const StopInfo& get_stop_info() const;
+
+		// while paused: retire everything in flight so the registers and get_current_address are architectural
+		void drain();
+		// while paused: execute exactly one more instruction and drain
+		void step_instruction();
+		// pauses at an instruction boundary
+		void halt();
+		void set_register(RegisterName reg, unsigned_data value);
+		void set_pc(unsigned_data pc);
 
 	private:
 		void interrupt();
 		void clock() const;
+		bool clock_checked();
+		[[nodiscard]] bool is_pipeline_empty() const;
+		RunState pause_for_update();
+		void resume_after_update(RunState previous_state);
 		void get_irq_free() const;
-		void start_uart_tx();
-		void stop_uart_tx();
+
+		void start_workers();
+		// moves PAUSED to state once every worker has parked, does nothing if the core is already running
+		void begin_run(RunState state, unsigned_data pc);
+		// true once the core is paused and every worker has parked, false if it is running
+		bool settle_paused();
+		bool settle_paused(unique_lock<mutex>& lock);
+		bool wait_while_paused();
+		void clock_loop();
+		void counter_loop();
+		void uart_loop();
+		void poll_uart();
+		void wait_until_paused();
+		[[nodiscard]] bool owns_devices() const;
+		[[nodiscard]] static bool is_running(RunState state);
 
 		unique_ptr<Stage::Fetch> fetch;
 		unique_ptr<Stage::Decode> decode;
@@ -76,12 +178,35 @@ namespace RV32IM
 
 		unique_ptr<RegisterFile> register_file;
 		shared_ptr<UnifiedMemory> memory;
-		unique_ptr<BranchPrediction> branch;
+		unsigned_data hart_id;
+		unique_ptr<BranchPredictor> branch;
+		unique_ptr<BranchTargetBuffer> target_buffer;
+		unique_ptr<ReturnAddressStack> return_stack;
+		PredictorConfig predictor_config;
+		// what the predictor tables were built with, they follow page_backing on the next attach
+		PageBacking table_backing;
+		unique_ptr<PerformanceCounters> counters;
+		Statistics statistics;
+		unique_ptr<StatsExporter> stats_exporter;
+		unique_ptr<Profiler> profiler;
+		unique_ptr<CacheHierarchy> caches;
+		SymbolTable symbols;
+		unique_ptr<TraceWriter> trace_writer;
+		unique_ptr<BbvCollector> bbv;
+		LockstepChecker* lockstep;
+
+		unique_ptr<DebugPoints> debug_points;
+		StopInfo stop_info;
+		// a stop drains the pipeline first so every older instruction has retired when the core pauses
+		StopInfo pending_stop;
+		bool draining;
+		bool skip_breakpoint;
 
 		unique_ptr<VideoInterface> video_interface;
 		int video_width;
 		int video_height;
 		size_t memory_size;
+		PageBacking page_backing;
 
 		bool block_irq;
 
@@ -92,16 +217,21 @@ namespace RV32IM
 		chrono::time_point<chrono::steady_clock> end;
 		int desired_clock_time;
 
+		static constexpr int NUM_WORKERS = 3;
+		atomic<RunState> run_state;
+		atomic<unsigned_data> until_pc;
+		mutex run_mutex;
+		condition_variable run_changed;
+		int parked_workers;
+		bool workers_started;
+
 		thread clock_thread;
-		bool halt_clock;
 
 		uint8_t timer_counter;
 		thread counter_thread;
-		bool halt_counter;
 
 		string uart_data;
 		thread uart_tx_thread;
-		bool halt_uart;
 	};
 
 	
@@ -0,0 +1,123 @@
+#include "counter_table.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace RV32IM
+{
+	CounterTable::CounterTable(const size_t entries, const size_t tag_bits, const PageBacking backing) :
+		entries(1), index_bits(0), tag_bits(tag_bits)
+	{
+		assert(tag_bits <= 16);
+		// round up so the index can be masked instead of divided
+		while (this->entries < max(entries, static_cast<size_t>(4)))
+		{
+			this->entries <<= 1;
+			index_bits++;
+		}
+		// 4 counters per byte
+		counters = HugePageVector<uint8_t>(this->entries >> 2, 0, backing);
+		if (tag_bits > 8)
+			wide_tags = HugePageVector<uint16_t>(this->entries, 0, backing);
+		else if (tag_bits > 0)
+			narrow_tags = HugePageVector<uint8_t>(this->entries, 0, backing);
+	}
+
+	size_t CounterTable::get_index(const unsigned_data address) const
+	{
+		// RVC leaves instructions halfword aligned, fold the upper address bits into the index
+		const unsigned_data halfword = address >> 1;
+		return (halfword ^ (halfword >> index_bits)) & (entries - 1);
+	}
+
+	uint8_t CounterTable::read(const size_t index) const
+	{
+		return (counters[index >> 2] >> ((index & 0b11) << 1)) & 0b11;
+	}
+
+	void CounterTable::update(const size_t index, const bool branch_taken)
+	{
+		// 00 strong no branch
+		// 01 weak no branch
+		// 10 weak branch
+		// 11 strong branch
+		uint8_t counter = read(index);
+		if (branch_taken)
+		{
+			if (counter < 3)
+				counter++;
+		}
+		else
+		{
+			if (counter > 0)
+				counter--;
+		}
+		write(index, counter);
+	}
+
+	void CounterTable::reset()
+	{
+		ranges::fill(counters, 0);
+		ranges::fill(narrow_tags, 0);
+		ranges::fill(wide_tags, 0);
+	}
+
+	bool CounterTable::is_tagged() const
+	{
+		return tag_bits > 0;
+	}
+
+	bool CounterTable::matches(const size_t index, const unsigned_data address) const
+	{
+		return tag_bits == 0 || read_tag(index) == get_tag(address);
+	}
+
+	void CounterTable::allocate(const size_t index, const unsigned_data address, const bool branch_taken)
+	{
+		// new entries start weak so a single opposite outcome retrains them
+		if (tag_bits > 0)
+			write_tag(index, get_tag(address));
+		write(index, branch_taken ? 0b10 : 0b01);
+	}
+
+	size_t CounterTable::get_entries() const
+	{
+		return entries;
+	}
+
+	size_t CounterTable::get_index_bits() const
+	{
+		return index_bits;
+	}
+
+	size_t CounterTable::get_table_size() const
+	{
+		return counters.size() * sizeof(uint8_t) + narrow_tags.size() * sizeof(uint8_t) + wide_tags.size() * sizeof(uint16_t);
+	}
+
+	void CounterTable::write(const size_t index, const uint8_t counter)
+	{
+		const size_t shift = (index & 0b11) << 1;
+		counters[index >> 2] = static_cast<uint8_t>((counters[index >> 2] & ~(0b11 << shift)) | counter << shift);
+	}
+
+	uint16_t CounterTable::get_tag(const unsigned_data address) const
+	{
+		// tag 0 marks an empty entry
+		const auto tag = static_cast<uint16_t>((address >> (1 + index_bits)) & ((1 << tag_bits) - 1));
+		return tag == 0 ? 1 : tag;
+	}
+
+	uint16_t CounterTable::read_tag(const size_t index) const
+	{
+		return tag_bits > 8 ? wide_tags[index] : narrow_tags[index];
+	}
+
+	void CounterTable::write_tag(const size_t index, const uint16_t tag)
+	{
+		if (tag_bits > 8)
+			wide_tags[index] = tag;
+		else
+			narrow_tags[index] = static_cast<uint8_t>(tag);
+	}
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <vector>
+
+#include "common.h"
+#include "host_memory.h"
+
+namespace RV32IM
+{
+	// fixed size table of packed 2-bit saturating counters with optional partial tags
+	class CounterTable
+	{
+	public:
+		CounterTable(size_t entries, size_t tag_bits = 0, PageBacking backing = PageBacking::NORMAL);
+
+		[[nodiscard]] size_t get_index(unsigned_data address) const;
+		[[nodiscard]] uint8_t read(size_t index) const;
+		void update(size_t index, bool branch_taken);
+		void reset();
+
+		[[nodiscard]] bool is_tagged() const;
+		[[nodiscard]] bool matches(size_t index, unsigned_data address) const;
+		void allocate(size_t index, unsigned_data address, bool branch_taken);
+
+		[[nodiscard]] size_t get_entries() const;
+		[[nodiscard]] size_t get_index_bits() const;
+		[[nodiscard]] size_t get_table_size() const;
+
+	private:
+		void write(size_t index, uint8_t counter);
+		[[nodiscard]] uint16_t get_tag(unsigned_data address) const;
+		[[nodiscard]] uint16_t read_tag(size_t index) const;
+		void write_tag(size_t index, uint16_t tag);
+
+		HugePageVector<uint8_t> counters;
+		// a byte per tag up to 8 bits, only the array matching tag_bits is allocated
+		HugePageVector<uint8_t> narrow_tags;
+		HugePageVector<uint16_t> wide_tags;
+		size_t entries;
+		size_t index_bits;
+		size_t tag_bits;
+	};
+}
@@ -0,0 +1,114 @@
+#include "debug_points.h"
+
+#include <algorithm>
+
+namespace RV32IM
+{
+	namespace
+	{
+		constexpr size_t page_words = (size_t{ 1 } << (32 - DebugPoints::PAGE_BITS)) / 64;
+	}
+
+	DebugPoints::DebugPoints() : breakpoint_pages(page_words), watch_pages(page_words) {}
+
+	void DebugPoints::add_breakpoint(const unsigned_data pc)
+	{
+		if (ranges::find(breakpoints, pc) == breakpoints.end())
+			breakpoints.push_back(pc);
+		set_page(breakpoint_pages, pc);
+	}
+
+	bool DebugPoints::remove_breakpoint(const unsigned_data pc)
+	{
+		const auto found = ranges::find(breakpoints, pc);
+		if (found == breakpoints.end())
+			return false;
+		breakpoints.erase(found);
+		rebuild_pages();
+		return true;
+	}
+
+	void DebugPoints::add_watchpoint(const unsigned_data address, const unsigned_data size, const WatchType type)
+	{
+		watchpoints.push_back({ address, size == 0 ? 1 : size, type });
+		rebuild_pages();
+	}
+
+	bool DebugPoints::remove_watchpoint(const unsigned_data address, const unsigned_data size, const WatchType type)
+	{
+		const auto found = ranges::find_if(watchpoints, [&](const Watchpoint& watchpoint)
+			{
+				return watchpoint.address == address && watchpoint.size == (size == 0 ? 1 : size) && watchpoint.type == type;
+			});
+		if (found == watchpoints.end())
+			return false;
+		watchpoints.erase(found);
+		rebuild_pages();
+		return true;
+	}
+
+	void DebugPoints::clear()
+	{
+		breakpoints.clear();
+		watchpoints.clear();
+		rebuild_pages();
+	}
+
+	bool DebugPoints::empty() const
+	{
+		return breakpoints.empty() && watchpoints.empty();
+	}
+
+	bool DebugPoints::is_breakpoint(const unsigned_data pc) const
+	{
+		if (!test_page(breakpoint_pages, pc))
+			return false;
+		return ranges::find(breakpoints, pc) != breakpoints.end();
+	}
+
+	bool DebugPoints::is_watched(const unsigned_data address, const unsigned_data size, const WatchType access) const
+	{
+		// an access can straddle a page boundary, so test the page of its last byte too
+		if (!test_page(watch_pages, address) && !test_page(watch_pages, address + size - 1))
+			return false;
+		return ranges::any_of(watchpoints, [&](const Watchpoint& watchpoint)
+			{
+				return (watchpoint.type & access) && address < uint64_t{ watchpoint.address } + watchpoint.size &&
+					watchpoint.address < uint64_t{ address } + size;
+			});
+	}
+
+	const vector<unsigned_data>& DebugPoints::get_breakpoints() const
+	{
+		return breakpoints;
+	}
+
+	const vector<Watchpoint>& DebugPoints::get_watchpoints() const
+	{
+		return watchpoints;
+	}
+
+	bool DebugPoints::test_page(const vector<uint64_t>& pages, const unsigned_data address)
+	{
+		const unsigned_data page = address >> PAGE_BITS;
+		return pages[page >> 6] >> (page & 63) & 1;
+	}
+
+	void DebugPoints::set_page(vector<uint64_t>& pages, const unsigned_data address)
+	{
+		const unsigned_data page = address >> PAGE_BITS;
+		pages[page >> 6] |= uint64_t{ 1 } << (page & 63);
+	}
+
+	void DebugPoints::rebuild_pages()
+	{
+		ranges::fill(breakpoint_pages, 0);
+		ranges::fill(watch_pages, 0);
+		for (const unsigned_data pc : breakpoints)
+			set_page(breakpoint_pages, pc);
+		for (const auto& watchpoint : watchpoints)
+			for (uint64_t address = watchpoint.address & ~((1u << PAGE_BITS) - 1); address < uint64_t{ watchpoint.address } + watchpoint.size;
+				address += 1u << PAGE_BITS)
+				set_page(watch_pages, static_cast<unsigned_data>(address));
+	}
+}
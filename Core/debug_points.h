@@ -0,0 +1,68 @@
+#pragma once
+#include <vector>
+
+#include "common.h"
+
+namespace RV32IM
+{
+	enum WatchType : uint8_t
+	{
+		WATCH_READ = 0x1,
+		WATCH_WRITE = 0x2,
+		WATCH_ACCESS = WATCH_READ | WATCH_WRITE
+	};
+
+	enum class StopReason : uint8_t
+	{
+		NONE, BREAKPOINT, WATCHPOINT, RUN_UNTIL, INTERRUPT, STEP
+	};
+
+	// where and why the checked clock loop last paused the core, pc is the next instruction to execute
+	struct StopInfo
+	{
+		StopReason reason;
+		unsigned_data pc;
+		unsigned_data address;
+		WatchType access;
+	};
+
+	struct Watchpoint
+	{
+		unsigned_data address;
+		unsigned_data size;
+		WatchType type;
+	};
+
+	// PC breakpoints and memory watchpoints. Each kind keeps one bit per 4 KiB page so most lookups
+	// end after a single bit test, the exact lists are only scanned on pages that hold a debug point.
+	class DebugPoints
+	{
+	public:
+		static constexpr unsigned PAGE_BITS = 12;
+
+		DebugPoints();
+
+		void add_breakpoint(unsigned_data pc);
+		bool remove_breakpoint(unsigned_data pc);
+		void add_watchpoint(unsigned_data address, unsigned_data size, WatchType type);
+		bool remove_watchpoint(unsigned_data address, unsigned_data size, WatchType type);
+		void clear();
+
+		[[nodiscard]] bool empty() const;
+		[[nodiscard]] bool is_breakpoint(unsigned_data pc) const;
+		[[nodiscard]] bool is_watched(unsigned_data address, unsigned_data size, WatchType access) const;
+
+		[[nodiscard]] const vector<unsigned_data>& get_breakpoints() const;
+		[[nodiscard]] const vector<Watchpoint>& get_watchpoints() const;
+
+	private:
+		static bool test_page(const vector<uint64_t>& pages, unsigned_data address);
+		static void set_page(vector<uint64_t>& pages, unsigned_data address);
+		void rebuild_pages();
+
+		vector<unsigned_data> breakpoints;
+		vector<Watchpoint> watchpoints;
+		vector<uint64_t> breakpoint_pages;
+		vector<uint64_t> watch_pages;
+	};
+}
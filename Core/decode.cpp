@@ -15,6 +15,19 @@ namespace RV32IM
 		{
 		}
 
+		void Decode::reset()
+		{
+			reg_instruction.reset();
+			reg_rs1.reset();
+			reg_rs2.reset();
+			reg_PC.reset();
+			reg_predicted_PC.reset();
+			bubble = false;
+			hazard = false;
+			irq_counter = 0;
+			irq_return_address = 0;
+		}
+
 		void Decode::clock()
 		{
 			reg_instruction.clock();
@@ -39,6 +52,7 @@ namespace RV32IM
 				else
 				{
 					reg_instruction = InstructionNOP();
+					core->counters->count_bubble();
 					return;
 				}
 				
@@ -50,6 +64,7 @@ namespace RV32IM
 			if (bubble)
 			{
 				reg_instruction = InstructionNOP();
+				core->counters->count_bubble();
 				return;
 			}
 
@@ -105,6 +120,12 @@ namespace RV32IM
 				reg_rs2 = reg_value;
 			}
 
+			if (hazard)
+			{
+				core->counters->count_stall();
+				if (core->profiler)
+					core->profiler->record_stall(reg_PC.get_input());
+			}
 			core->fetch->stall(hazard);
 			insert_bubble(hazard);
 		}
@@ -137,13 +158,13 @@ namespace RV32IM
 				return false;
 			const Instruction execute_instruction = core->execute->reg_instruction.get_input();
 			const Instruction memory_instruction = core->memory_stage->reg_instruction.get_input();
-			const Instruction write_back_instruction = core->write_back->reg_instruction.get_input();
 			forward = false;
 
 			if (execute_instruction.rd == reg)
 			{
 				if (execute_instruction.opcode == Opcodes::RI || 
-					execute_instruction.opcode == Opcodes::RR)
+					execute_instruction.opcode == Opcodes::RR ||
+					execute_instruction.opcode == Opcodes::SYSTEM)
 				{
 					forward = true;
 					forward_data = core->execute->reg_alu.get_input();
@@ -152,25 +173,21 @@ namespace RV32IM
 			}
 			if (memory_instruction.rd == reg)
 			{
-				if (memory_instruction.opcode == Opcodes::LX)
+				if (memory_instruction.opcode == Opcodes::LX || memory_instruction.opcode == Opcodes::AMO)
 				{
 					forward = true;
 					forward_data = core->memory_stage->reg_mem_in.get_input();
 				}
 				if (memory_instruction.opcode == Opcodes::RI ||
-					memory_instruction.opcode == Opcodes::RR)
+					memory_instruction.opcode == Opcodes::RR ||
+					memory_instruction.opcode == Opcodes::SYSTEM)
 				{
 					forward = true;
 					forward_data = core->memory_stage->reg_alu.get_input();
 				}
 				return true;
 			}
-			if (write_back_instruction.rd == reg)
-			{
-				forward = true;
-				forward_data = core->write_back->reg_wb_value.get_input();
-				return true;
-			}
+			// the value write-back is committing comes through the register file's bypass
 			return false;
 
 		}
@@ -11,6 +11,7 @@ namespace RV32IM
 		class Decode : virtual public BaseStage
 		{
 		public:
+			friend class RV32IM::Core;
 			friend class Fetch;
 			friend class Execute;
 			friend class Memory;
@@ -19,6 +20,7 @@ namespace RV32IM
 			Decode(Core* core);
 			void clock() override;
 			void run() override;
+			void reset() override;
 			void insert_bubble(bool bubble);
 			void stall(bool stall);
 			void irq();
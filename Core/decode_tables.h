@@ -0,0 +1,234 @@
+#pragma once
+#include <array>
+
+#include "common.h"
+
+namespace RV32IM
+{
+	// what an instruction does, resolved once at decode so execution switches on a single byte
+	enum class Operation : uint8_t
+	{
+		ADD, SUB, SLL, SLT, SLTU, XOR, SRL, SRA, OR, AND,
+		MUL, MULH, MULHSU, MULHU, DIV, DIVU, REM, REMU,
+		LB, LH, LW, LBU, LHU,
+		SB, SH, SW,
+		BEQ, BNE, BLT, BGE, BLTU, BGEU,
+		LUI, AUIPC, JAL, JALR,
+		AMO, SYSTEM,
+		INVALID
+	};
+
+	enum OperandUsage : uint8_t
+	{
+		USES_RS1 = 1, USES_RS2 = 2, WRITES_RD = 4
+	};
+
+	// fields of a 32 bit encoding, each a shift and a mask
+	constexpr Opcodes decode_opcode(const inst_data data) { return static_cast<Opcodes>(data & 0x7F); }
+	constexpr RegisterName decode_rd(const inst_data data) { return static_cast<RegisterName>(data >> 7 & 0x1F); }
+	constexpr Funct3 decode_funct3(const inst_data data) { return static_cast<Funct3>(data >> 12 & 0x7); }
+	constexpr RegisterName decode_rs1(const inst_data data) { return static_cast<RegisterName>(data >> 15 & 0x1F); }
+	constexpr RegisterName decode_rs2(const inst_data data) { return static_cast<RegisterName>(data >> 20 & 0x1F); }
+	constexpr Funct7 decode_funct7(const inst_data data) { return static_cast<Funct7>(data >> 25); }
+
+	// sign extended immediates, the arithmetic shift of the top bit does the extension
+	constexpr unsigned_data immediate_i(const inst_data data)
+	{
+		return static_cast<unsigned_data>(static_cast<signed_data>(data) >> 20);
+	}
+
+	constexpr unsigned_data immediate_s(const inst_data data)
+	{
+		return static_cast<unsigned_data>(static_cast<signed_data>(data & 0xFE000000) >> 20) | (data >> 7 & 0x1F);
+	}
+
+	constexpr unsigned_data immediate_b(const inst_data data)
+	{
+		return static_cast<unsigned_data>(static_cast<signed_data>(data & 0x80000000) >> 19) | (data << 4 & 0x800) |
+			(data >> 20 & 0x7E0) | (data >> 7 & 0x1E);
+	}
+
+	constexpr unsigned_data immediate_u(const inst_data data)
+	{
+		return data & 0xFFFFF000;
+	}
+
+	constexpr unsigned_data immediate_j(const inst_data data)
+	{
+		return static_cast<unsigned_data>(static_cast<signed_data>(data & 0x80000000) >> 11) | (data & 0xFF000) |
+			(data >> 9 & 0x800) | (data >> 20 & 0x7FE);
+	}
+
+	static_assert(immediate_i(0xFFF00093) == 0xFFFFFFFF);	// addi x1, x0, -1
+	static_assert(immediate_s(0xFE112E23) == 0xFFFFFFFC);	// sw x1, -4(sp)
+	static_assert(immediate_b(0xFEB51EE3) == 0xFFFFFFFC);	// bne a0, a1, -4
+	static_assert(immediate_b(0x00B50463) == 0x8);			// beq a0, a1, 8
+	static_assert(immediate_u(0x123450B7) == 0x12345000);	// lui x1, 0x12345
+	static_assert(immediate_j(0xFFDFF0EF) == 0xFFFFFFFC);	// jal ra, -4
+	static_assert(immediate_j(0x008000EF) == 0x8);			// jal ra, 8
+
+	namespace DecodeTables
+	{
+		struct OpcodeEntry
+		{
+			bool valid;
+			InstructionFormat format;
+		};
+
+		// indexed by bits 6:2, every 32 bit encoding has 0b11 in bits 1:0
+		constexpr array<OpcodeEntry, 32> generate_opcodes()
+		{
+			array<OpcodeEntry, 32> table{};
+			const auto set = [&](const Opcodes opcode, const InstructionFormat format) { table[opcode >> 2] = { true, format }; };
+			set(RR, InstructionFormat::R);
+			set(AMO, InstructionFormat::R);
+			set(RI, InstructionFormat::I);
+			set(LX, InstructionFormat::I);
+			set(JALR, InstructionFormat::I);
+			set(SYSTEM, InstructionFormat::I);
+			set(SX, InstructionFormat::S);
+			set(BXX, InstructionFormat::B);
+			set(LUI, InstructionFormat::U);
+			set(AUIPC, InstructionFormat::U);
+			set(JAL, InstructionFormat::J);
+			return table;
+		}
+
+		constexpr array<uint8_t, 6> generate_operand_usage()
+		{
+			array<uint8_t, 6> table{};
+			table[static_cast<size_t>(InstructionFormat::R)] = USES_RS1 | USES_RS2 | WRITES_RD;
+			table[static_cast<size_t>(InstructionFormat::I)] = USES_RS1 | WRITES_RD;
+			table[static_cast<size_t>(InstructionFormat::S)] = USES_RS1 | USES_RS2;
+			table[static_cast<size_t>(InstructionFormat::B)] = USES_RS1 | USES_RS2;
+			table[static_cast<size_t>(InstructionFormat::U)] = WRITES_RD;
+			table[static_cast<size_t>(InstructionFormat::J)] = WRITES_RD;
+			return table;
+		}
+
+		// funct7 folded to the three values RV32IM defines, 3 marks the rest
+		constexpr array<uint8_t, 128> generate_funct7_variants()
+		{
+			array<uint8_t, 128> table{};
+			for (uint8_t& variant : table)
+				variant = 3;
+			table[NORM] = 0;
+			table[INV] = 1;
+			table[M_EXT] = 2;
+			return table;
+		}
+
+		constexpr size_t operation_index(const size_t opcode_index, const size_t funct3, const size_t variant)
+		{
+			return opcode_index << 5 | funct3 << 2 | variant;
+		}
+
+		// indexed by opcode bits 6:2, funct3 and the funct7 variant
+		constexpr array<Operation, 1024> generate_operations()
+		{
+			array<Operation, 1024> table{};
+			for (Operation& operation : table)
+				operation = Operation::INVALID;
+
+			const auto set = [&](const Opcodes opcode, const size_t funct3, const size_t variant, const Operation operation)
+			{
+				table[operation_index(opcode >> 2, funct3, variant)] = operation;
+			};
+			// for formats without funct7 the upper bits belong to the immediate
+			const auto set_any_variant = [&](const Opcodes opcode, const size_t funct3, const Operation operation)
+			{
+				for (size_t variant = 0; variant < 4; variant++)
+					set(opcode, funct3, variant, operation);
+			};
+			const auto set_any = [&](const Opcodes opcode, const Operation operation)
+			{
+				for (size_t funct3 = 0; funct3 < 8; funct3++)
+					set_any_variant(opcode, funct3, operation);
+			};
+
+			constexpr array<Operation, 8> base = {
+				Operation::ADD, Operation::SLL, Operation::SLT, Operation::SLTU,
+				Operation::XOR, Operation::SRL, Operation::OR, Operation::AND
+			};
+			constexpr array<Operation, 8> multiply = {
+				Operation::MUL, Operation::MULH, Operation::MULHSU, Operation::MULHU,
+				Operation::DIV, Operation::DIVU, Operation::REM, Operation::REMU
+			};
+			for (size_t funct3 = 0; funct3 < 8; funct3++)
+			{
+				set(RR, funct3, 0, base[funct3]);
+				set(RR, funct3, 2, multiply[funct3]);
+				if (funct3 != SLL && funct3 != SRL)
+					set_any_variant(RI, funct3, base[funct3]);
+			}
+			set(RR, SUB, 1, Operation::SUB);
+			set(RR, SRA, 1, Operation::SRA);
+			// shift amounts are 5 bits, imm[11:5] must be zero or select SRAI
+			set(RI, SLL, 0, Operation::SLL);
+			set(RI, SRL, 0, Operation::SRL);
+			set(RI, SRA, 1, Operation::SRA);
+
+			set_any_variant(LX, LB, Operation::LB);
+			set_any_variant(LX, LH, Operation::LH);
+			set_any_variant(LX, LW, Operation::LW);
+			set_any_variant(LX, LBU, Operation::LBU);
+			set_any_variant(LX, LHU, Operation::LHU);
+			set_any_variant(SX, SB, Operation::SB);
+			set_any_variant(SX, SH, Operation::SH);
+			set_any_variant(SX, SW, Operation::SW);
+			set_any_variant(BXX, BEQ, Operation::BEQ);
+			set_any_variant(BXX, BNE, Operation::BNE);
+			set_any_variant(BXX, BLT, Operation::BLT);
+			set_any_variant(BXX, BGE, Operation::BGE);
+			set_any_variant(BXX, BLTU, Operation::BLTU);
+			set_any_variant(BXX, BGEU, Operation::BGEU);
+			set_any_variant(JALR, 0, Operation::JALR);
+			// funct5 is checked by Fetch::is_valid_atomic
+			set_any_variant(AMO, 0x2, Operation::AMO);
+			set_any(SYSTEM, Operation::SYSTEM);
+			set_any(LUI, Operation::LUI);
+			set_any(AUIPC, Operation::AUIPC);
+			set_any(JAL, Operation::JAL);
+			return table;
+		}
+
+		inline constexpr array<OpcodeEntry, 32> opcodes = generate_opcodes();
+		inline constexpr array<uint8_t, 6> operand_usage = generate_operand_usage();
+		inline constexpr array<uint8_t, 128> funct7_variants = generate_funct7_variants();
+		inline constexpr array<Operation, 1024> operations = generate_operations();
+	}
+
+	// INVALID for opcodes without 0b11 in bits 1:0 too, those are RVC and must be expanded first
+	constexpr Operation decode_operation(const inst_data data)
+	{
+		if ((data & 0x3) != 0x3)
+			return Operation::INVALID;
+		return DecodeTables::operations[DecodeTables::operation_index(data >> 2 & 0x1F, data >> 12 & 0x7,
+			DecodeTables::funct7_variants[data >> 25])];
+	}
+
+	constexpr bool is_valid_opcode(const inst_data data)
+	{
+		return (data & 0x3) == 0x3 && DecodeTables::opcodes[data >> 2 & 0x1F].valid;
+	}
+
+	constexpr InstructionFormat decode_format(const inst_data data)
+	{
+		return DecodeTables::opcodes[data >> 2 & 0x1F].format;
+	}
+
+	constexpr uint8_t get_operand_usage(const InstructionFormat format)
+	{
+		return DecodeTables::operand_usage[static_cast<size_t>(format)];
+	}
+
+	static_assert(decode_operation(0x00000013) == Operation::ADD);		// nop
+	static_assert(decode_operation(0x40B50533) == Operation::SUB);		// sub a0, a0, a1
+	static_assert(decode_operation(0x02B54533) == Operation::DIV);		// div a0, a0, a1
+	static_assert(decode_operation(0x40155513) == Operation::SRA);		// srai a0, a0, 1
+	static_assert(decode_operation(0x02155513) == Operation::INVALID);	// srli with imm[11:5] = 1
+	static_assert(decode_operation(0xFFF54513) == Operation::XOR);		// xori a0, a0, -1
+	static_assert(decode_operation(0xFEB51EE3) == Operation::BNE);
+	static_assert(decode_operation(0x0000A003) == Operation::LW);
+	static_assert(decode_operation(0x0000B003) == Operation::INVALID);	// ld is RV64
+}
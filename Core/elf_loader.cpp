@@ -0,0 +1,202 @@
+#include "elf_loader.h"
+
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+namespace RV32IM
+{
+	namespace
+	{
+		struct Elf32Header
+		{
+			uint8_t ident[16];
+			uint16_t type;
+			uint16_t machine;
+			uint32_t version;
+			uint32_t entry;
+			uint32_t program_header_offset;
+			uint32_t section_header_offset;
+			uint32_t flags;
+			uint16_t header_size;
+			uint16_t program_header_size;
+			uint16_t program_header_count;
+			uint16_t section_header_size;
+			uint16_t section_header_count;
+			uint16_t section_name_index;
+		};
+
+		struct Elf32ProgramHeader
+		{
+			uint32_t type;
+			uint32_t offset;
+			uint32_t virtual_address;
+			uint32_t physical_address;
+			uint32_t file_size;
+			uint32_t memory_size;
+			uint32_t flags;
+			uint32_t align;
+		};
+
+		struct Elf32SectionHeader
+		{
+			uint32_t name;
+			uint32_t type;
+			uint32_t flags;
+			uint32_t address;
+			uint32_t offset;
+			uint32_t size;
+			uint32_t link;
+			uint32_t info;
+			uint32_t address_align;
+			uint32_t entry_size;
+		};
+
+		struct Elf32Symbol
+		{
+			uint32_t name;
+			uint32_t value;
+			uint32_t size;
+			uint8_t info;
+			uint8_t other;
+			uint16_t section_index;
+		};
+
+		constexpr uint8_t ELF_MAGIC[4] = { 0x7F, 'E', 'L', 'F' };
+		constexpr uint8_t ELF_CLASS_32 = 1;
+		constexpr uint8_t ELF_DATA_LSB = 1;
+		constexpr uint16_t ELF_MACHINE_RISCV = 0xF3;
+		constexpr uint32_t PT_LOAD = 1;
+		constexpr uint32_t SHT_SYMTAB = 2;
+		constexpr uint8_t STT_OBJECT = 1;
+		constexpr uint8_t STT_FUNC = 2;
+		constexpr uint8_t STT_NOTYPE = 0;
+		// the memory mapped I/O registers fill the top of guest memory, vga_mode is the lowest of them
+		constexpr unsigned_data IO_REGION_SIZE = offset_vga_mode;
+
+		// offsets and sizes come from the file, so check them before seeking or allocating
+		bool fits_in_file(const uint32_t offset, const uint32_t size, const uint64_t file_size)
+		{
+			return static_cast<uint64_t>(offset) + size <= file_size;
+		}
+
+		template <typename T>
+		T read_struct(ifstream& file, const uint32_t offset)
+		{
+			T value;
+			file.seekg(offset, ios::beg);
+			file.read(reinterpret_cast<char*>(&value), sizeof(T));
+			if (!file)
+				throw ElfLoadError("Truncated ELF file!");
+			return value;
+		}
+
+		void read_symbols(ifstream& file, const uint64_t file_size, const Elf32Header& header, SymbolTable& symbols)
+		{
+			if (header.section_header_offset == 0 || header.section_header_size != sizeof(Elf32SectionHeader))
+				return;
+
+			for (uint16_t section{ 0 }; section < header.section_header_count; section++)
+			{
+				const auto symbol_section = read_struct<Elf32SectionHeader>(
+					file, header.section_header_offset + section * sizeof(Elf32SectionHeader));
+				if (symbol_section.type != SHT_SYMTAB || symbol_section.link >= header.section_header_count)
+					continue;
+
+				// symbol names live in the string table named by sh_link
+				const auto string_section = read_struct<Elf32SectionHeader>(
+					file, header.section_header_offset + symbol_section.link * sizeof(Elf32SectionHeader));
+				if (!fits_in_file(symbol_section.offset, symbol_section.size, file_size) ||
+					!fits_in_file(string_section.offset, string_section.size, file_size))
+					throw ElfLoadError("ELF symbol table lies outside the file!");
+				vector<char> strings(string_section.size + 1, '\0');
+				file.seekg(string_section.offset, ios::beg);
+				file.read(strings.data(), string_section.size);
+
+				const uint32_t symbol_count = symbol_section.size / sizeof(Elf32Symbol);
+				for (uint32_t index{ 1 }; index < symbol_count; index++)
+				{
+					const auto symbol = read_struct<Elf32Symbol>(file, symbol_section.offset + index * sizeof(Elf32Symbol));
+					const uint8_t symbol_type = symbol.info & 0xF;
+					if (symbol_type != STT_FUNC && symbol_type != STT_OBJECT && symbol_type != STT_NOTYPE)
+						continue;
+					if (symbol.section_index == 0 || symbol.name >= string_section.size || strings[symbol.name] == '\0')
+						continue;
+					symbols.add_symbol(&strings[symbol.name], symbol.value, symbol.size);
+				}
+			}
+			symbols.sort();
+		}
+	}
+
+	bool ElfLoader::is_elf_file(const string& file_path)
+	{
+		ifstream file(file_path, ios::binary);
+		uint8_t magic[4] = {};
+		file.read(reinterpret_cast<char*>(magic), sizeof(magic));
+		return file && memcmp(magic, ELF_MAGIC, sizeof(ELF_MAGIC)) == 0;
+	}
+
+	ProgramImage ElfLoader::load(const string& file_path, size_t memory_size)
+	{
+		ifstream file(file_path, ios::binary | ios::ate);
+		if (!file)
+			throw ElfLoadError("Unable to open ELF file!");
+		const auto file_size = static_cast<uint64_t>(file.tellg());
+
+		const auto header = read_struct<Elf32Header>(file, 0);
+		if (memcmp(header.ident, ELF_MAGIC, sizeof(ELF_MAGIC)) != 0)
+			throw ElfLoadError("Not an ELF file!");
+		if (header.ident[4] != ELF_CLASS_32 || header.ident[5] != ELF_DATA_LSB || header.machine != ELF_MACHINE_RISCV)
+			throw ElfLoadError("ELF file is not little endian RV32!");
+		if (header.program_header_size != sizeof(Elf32ProgramHeader))
+			throw ElfLoadError("Unsupported ELF program header size!");
+
+		vector<Elf32ProgramHeader> segments;
+		unsigned_data highest_address = 0;
+		for (uint16_t index{ 0 }; index < header.program_header_count; index++)
+		{
+			const auto segment = read_struct<Elf32ProgramHeader>(
+				file, header.program_header_offset + index * sizeof(Elf32ProgramHeader));
+			if (segment.type != PT_LOAD || segment.memory_size == 0)
+				continue;
+			if (segment.file_size > segment.memory_size)
+				throw ElfLoadError("ELF segment is larger on disk than in memory!");
+			if (segment.virtual_address + segment.memory_size < segment.virtual_address)
+				throw ElfLoadError("ELF segment wraps the address space!");
+			if (!fits_in_file(segment.offset, segment.file_size, file_size))
+				throw ElfLoadError("Truncated ELF segment!");
+			segments.push_back(segment);
+			highest_address = max(highest_address, segment.virtual_address + segment.memory_size);
+		}
+
+		// memory is addressed with a mask, so it must be a power of 2
+		if (memory_size == 0)
+		{
+			memory_size = 0x100000;
+			while (memory_size - IO_REGION_SIZE < highest_address)
+				memory_size <<= 1;
+		}
+		if ((memory_size & (memory_size - 1)) != 0 || memory_size <= IO_REGION_SIZE)
+			throw ElfLoadError("Memory size must be a power of 2!");
+		if (highest_address > memory_size)
+			throw ElfLoadError("ELF segments do not fit in guest memory!");
+		if (highest_address > memory_size - IO_REGION_SIZE)
+			throw ElfLoadError("ELF segment overlaps the I/O registers!");
+
+		ProgramImage image{ shared_ptr<uint8_t[]>(new uint8_t[memory_size]), memory_size, header.entry, {} };
+		memset(image.memory.get(), 0, memory_size);
+
+		// read each segment straight into guest memory, .bss stays zeroed
+		for (const auto& segment : segments)
+		{
+			file.seekg(segment.offset, ios::beg);
+			file.read(reinterpret_cast<char*>(image.memory.get() + segment.virtual_address), segment.file_size);
+			if (!file)
+				throw ElfLoadError("Truncated ELF segment!");
+		}
+
+		read_symbols(file, file_size, header, image.symbols);
+		return image;
+	}
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <exception>
+#include <memory>
+#include <string>
+
+#include "common.h"
+#include "program_image.h"
+
+namespace RV32IM
+{
+	class ElfLoader
+	{
+	public:
+		static bool is_elf_file(const string& file_path);
+
+		// memory_size of 0 picks the smallest power of 2 (at least 1 MiB) that holds every segment below the I/O registers
+		static ProgramImage load(const string& file_path, size_t memory_size = 0);
+	};
+
+	class ElfLoadError : public exception
+	{
+	public:
+		explicit ElfLoadError(string message) : message(std::move(message)) {}
+
+		const char* what() const noexcept override
+		{
+			return message.c_str();
+		}
+
+	private:
+		string message;
+	};
+}
@@ -11,6 +11,15 @@ namespace RV32IM
 	{
 		Execute::Execute(Core* main_core): BaseStage(main_core), invalid_prediction(false) {}
 
+		void Execute::reset()
+		{
+			reg_instruction.reset();
+			reg_alu.reset();
+			reg_PC.reset();
+			reg_rs2.reset();
+			invalid_prediction = false;
+		}
+
 		void Execute::clock()
 		{
 			reg_instruction.clock();
@@ -27,7 +36,12 @@ namespace RV32IM
 			const unsigned_data rs2 = core->decode->reg_rs2;
 			const unsigned_data pc = core->decode->reg_PC;
 
-			const unsigned_data alu_result = ALU::get_result(instruction, rs1, rs2, pc);
+			// CSR reads bypass the ALU, writes are ignored since all implemented CSRs are read-only
+			unsigned_data alu_result;
+			if (instruction.opcode == Opcodes::SYSTEM)
+				alu_result = (instruction.immediate & 0xFFF) == MHARTID ? core->hart_id : core->counters->read_csr(instruction.immediate & 0xFFF);
+			else
+				alu_result = ALU::get_result(instruction, rs1, rs2, pc);
 
 			reg_instruction = instruction;
 			reg_alu = alu_result;
@@ -46,16 +60,25 @@ namespace RV32IM
 					invalid_prediction = true;
 				break;
 			default:
-				next_pc = pc + 4;
+				next_pc = pc + instruction.length;
 				invalid_prediction = false;
 			}
-			// if branch instruction, a branch only occurs if the next PC != pc + 4
+			// if branch instruction, a branch only occurs if the next PC is not the sequential one
 			if (instruction.opcode == Opcodes::BXX)
-				core->branch->update_table(pc, next_pc != pc + 4); // keep record of branch for current address
+			{
+				core->branch->update_table(pc, next_pc != pc + instruction.length); // keep record of branch for current address
+				core->branch->record_prediction(!invalid_prediction);
+			}
+			if (instruction.opcode == Opcodes::JALR)
+				core->target_buffer->update(pc, next_pc);
 
 			if (invalid_prediction)
 			{
+				core->counters->count_mispredict();
+				if (core->profiler)
+					core->profiler->record_mispredict(pc);
 				core->decode->insert_bubble(true);
+				core->fetch->squash(1);
 				core->fetch->notify_jump(true, next_pc);
 			}
 			else
@@ -11,6 +11,7 @@ namespace RV32IM
 		class Execute : virtual public BaseStage
 		{
 		public:
+			friend class RV32IM::Core;
 			friend class Fetch;
 			friend class Decode;
 			friend class Memory;
@@ -19,6 +20,7 @@ namespace RV32IM
 			Execute(Core* core);
 			void clock() override;
 			void run() override;
+			void reset() override;
 
 		private:
 			Register<Instruction> reg_instruction;
@@ -1,12 +1,23 @@
 #include "fetch.h"
 
+#include "compressed.h"
 #include "core.h"
 
 namespace RV32IM
 {
 	namespace Stage
 	{
-		Fetch::Fetch(Core* main_core) : BaseStage(main_core), PC(0), jump_occurred(false) {}
+		Fetch::Fetch(Core* main_core) : BaseStage(main_core), PC(0), jump_occurred(false), return_stack_checkpoints() {}
+
+		void Fetch::reset()
+		{
+			reg_PC.reset();
+			reg_predicted_PC.reset();
+			reg_instruction.reset();
+			PC = 0;
+			jump_occurred = false;
+			return_stack_checkpoints = {};
+		}
 
 		void Fetch::clock()
 		{
@@ -25,16 +36,18 @@ namespace RV32IM
 			else  // otherwise use the predicted address
 				temp_PC = reg_predicted_PC;
 
-			// our prediction will be PC+4 unless we are loading a branch or jump instruction
+			// our prediction will be the next sequential instruction unless we are loading a branch or jump instruction
+			const auto current_instruction = parse_instruction(read_instruction(*core->memory, temp_PC));
+			if (core->caches)
+				core->caches->fetch(temp_PC, current_instruction.length);
 			reg_PC = temp_PC;
-			reg_predicted_PC = temp_PC + 4;
-
-			const auto current_instruction = parse_instruction(core->memory->read_word(temp_PC));
+			reg_predicted_PC = temp_PC + current_instruction.length;
+			checkpoint_return_stack();
 
 			// if new instruction is a branch, ask BranchPredictor for a prediction
 			if (current_instruction.opcode == Opcodes::BXX)
 			{
-				if (core->branch->take_branch(temp_PC))
+				if (core->branch->take_branch(temp_PC, temp_PC + current_instruction.immediate))
 					reg_predicted_PC = temp_PC + current_instruction.immediate;
 			}
 
@@ -42,10 +55,57 @@ namespace RV32IM
 			if (current_instruction.type == InstructionFormat::J)
 				reg_predicted_PC = temp_PC + current_instruction.immediate;
 
+			// indirect jumps depend on a register, so predict returns with the stack and everything else with the BTB
+			// while stalled the same instruction is fetched again next cycle, so leave the stack alone
+			if (current_instruction.opcode == Opcodes::JALR)
+			{
+				unsigned_data target;
+				if (is_link_register(current_instruction.rs1) && current_instruction.rs1 != current_instruction.rd)
+				{
+					if (reg_instruction.get_write_enable() && core->return_stack->pop(target))
+						reg_predicted_PC = target;
+				}
+				else if (core->target_buffer->lookup(temp_PC, target))
+					reg_predicted_PC = target;
+			}
+
+			if ((current_instruction.opcode == Opcodes::JAL || current_instruction.opcode == Opcodes::JALR) &&
+				is_link_register(current_instruction.rd) && reg_instruction.get_write_enable())
+				core->return_stack->push(temp_PC + current_instruction.length);
+
 			// set the instruction data in pipeline register
 			reg_instruction = current_instruction;
 		}
 
+		void Fetch::hold()
+		{
+			const unsigned_data next_PC = get_next_PC();
+			reg_PC = next_PC;
+			reg_predicted_PC = next_PC;
+			reg_instruction = InstructionNOP();
+			checkpoint_return_stack();
+		}
+
+		void Fetch::checkpoint_return_stack()
+		{
+			// a stalled fetch is repeated next cycle without touching the stack, so only latched fetches move the history
+			if (!reg_instruction.get_write_enable())
+				return;
+			return_stack_checkpoints[1] = return_stack_checkpoints[0];
+			return_stack_checkpoints[0] = core->return_stack->checkpoint();
+		}
+
+		void Fetch::squash(const size_t instructions)
+		{
+			core->return_stack->restore(return_stack_checkpoints[min<size_t>(instructions, 2) - 1]);
+			return_stack_checkpoints.fill(core->return_stack->checkpoint());
+		}
+
+		unsigned_data Fetch::get_next_PC() const
+		{
+			return jump_occurred ? PC : reg_predicted_PC.read();
+		}
+
 		void Fetch::notify_jump(const bool jump, const unsigned_data pc)
 		{
 			// when jump occurs in future branch, we must go there
@@ -60,34 +120,87 @@ namespace RV32IM
 			reg_instruction.set_write_enable(!stall);
 		}
 
+		bool Fetch::is_valid_atomic(const inst_data instruction_data)
+		{
+			// only the word sized operations exist on RV32, and LR has no rs2
+			if ((instruction_data >> 12 & 0x7) != 0x2)
+				return false;
+			switch (instruction_data >> 27)
+			{
+			case LR_W:
+				return (instruction_data >> 20 & 0x1F) == 0;
+			case SC_W:
+			case AMOSWAP_W:
+			case AMOADD_W:
+			case AMOXOR_W:
+			case AMOAND_W:
+			case AMOOR_W:
+			case AMOMIN_W:
+			case AMOMAX_W:
+			case AMOMINU_W:
+			case AMOMAXU_W:
+				return true;
+			default:
+				return false;
+			}
+		}
+
+		bool Fetch::is_link_register(const RegisterName reg)
+		{
+			// calling convention hint from the ISA spec, ra and t0 are used as link registers
+			return reg == ra || reg == t0;
+		}
+
+		void Fetch::set_entry_point(const unsigned_data pc)
+		{
+			// the next fetch reads from the predicted PC, so latch the entry point there
+			reg_PC = pc;
+			reg_PC.clock();
+			reg_predicted_PC = pc;
+			reg_predicted_PC.clock();
+			jump_occurred = false;
+		}
+
+		inst_data Fetch::read_instruction(const UnifiedMemory& memory, const unsigned_data pc)
+		{
+			// a 32 bit instruction may sit on any halfword, so read it in halves to wrap at the end of memory like data does
+			const inst_data low = memory.read_half_word(pc);
+			if (is_compressed(low))
+				return low;
+			return low | static_cast<inst_data>(memory.read_half_word(pc + 2)) << 16;
+		}
+
 		Instruction Fetch::parse_instruction(const inst_data& instruction_data)
 		{
-			switch (instruction_data & 0x7f)
+			if (is_compressed(instruction_data))
 			{
-			case Opcodes::RR:
-				return InstructionR(instruction_data);
+				const inst_data expanded = expand_compressed(static_cast<uint16_t>(instruction_data));
+				Instruction instruction = expanded == 0 ? InstructionNOP() : parse_instruction(expanded);
+				instruction.length = 2;
+				return instruction;
+			}
 
-			case Opcodes::RI:
-			case Opcodes::LX:
-			case Opcodes::JALR:
-				return InstructionI(instruction_data);
+			// reserved funct3/funct7 combinations decode like unknown opcodes
+			const Operation operation = decode_operation(instruction_data);
+			if (operation == Operation::INVALID || (operation == Operation::AMO && !is_valid_atomic(instruction_data)))
+				return InstructionNOP();
 
-			case Opcodes::SX:
+			switch (decode_format(instruction_data))
+			{
+			case InstructionFormat::R:
+				return InstructionR(instruction_data);
+			case InstructionFormat::I:
+				return InstructionI(instruction_data);
+			case InstructionFormat::S:
 				return InstructionS(instruction_data);
-
-			case Opcodes::BXX:
+			case InstructionFormat::B:
 				return InstructionB(instruction_data);
-
-			case Opcodes::AUIPC:
-			case Opcodes::LUI:
+			case InstructionFormat::U:
 				return InstructionU(instruction_data);
-
-			case Opcodes::JAL:
+			case InstructionFormat::J:
 				return InstructionJ(instruction_data);
-
-			default:
-				return InstructionNOP();
 			}
+			return InstructionNOP();
 		}
 	}
 }
\ No newline at end of file
@@ -1,8 +1,12 @@
 #pragma once
+#include <array>
+
 #include "base_stage.h"
+#include "branch_target.h"
 #include "common.h"
 #include "instruction.h"
 #include "register.h"
+#include "unified_memory.h"
 
 namespace RV32IM
 {
@@ -11,7 +15,7 @@ namespace RV32IM
 		class Fetch : virtual public BaseStage
 		{
 		public:
-			friend class Core;
+			friend class RV32IM::Core;
 			friend class Decode;
 			friend class Execute;
 			friend class Memory;
@@ -20,8 +24,22 @@ namespace RV32IM
 			Fetch(Core* core);
 			void clock() override;
 			void run() override;
+			void reset() override;
+			// run() variant that fetches nothing, so the pipeline drains while the next PC is kept
+			void hold();
+			[[nodiscard]] unsigned_data get_next_PC() const;
 			void notify_jump(bool jump, unsigned_data pc);
 			void stall(bool stall);
+			void set_entry_point(unsigned_data pc);
+			// undoes the return stack changes of the youngest fetched instructions when they are squashed
+			void squash(size_t instructions);
+
+			// RVC encodings are expanded, the result's length tells how far the next instruction is
+			static Instruction parse_instruction(const inst_data& instruction_data);
+			// the 16 or 32 bits of the instruction at pc
+			static inst_data read_instruction(const UnifiedMemory& memory, unsigned_data pc);
+			// the profiler shares the fetch stage's idea of calls and returns
+			static bool is_link_register(RegisterName reg);
 
 		private:
 			Register<unsigned_data> reg_PC;
@@ -29,8 +47,12 @@ namespace RV32IM
 			Register<Instruction> reg_instruction;
 			unsigned_data PC;
 			bool jump_occurred;
+			// return stack state before the instruction in reg_instruction was fetched, then before the one ahead of it
+			array<ReturnStackCheckpoint, 2> return_stack_checkpoints;
 
-			static Instruction parse_instruction(const inst_data& instruction_data);
+			void checkpoint_return_stack();
+
+			static bool is_valid_atomic(inst_data instruction_data);
 
 		};
 	}
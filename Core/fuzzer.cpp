@@ -0,0 +1,116 @@
+#include "fuzzer.h"
+
+#include "core.h"
+#include "interpreter.h"
+#include "lockstep.h"
+#include "program_generator.h"
+
+namespace RV32IM
+{
+	namespace
+	{
+		// the pipeline may need several cycles per instruction, anything beyond this is treated as a hang
+		constexpr uint64_t max_cycles_per_instruction = 32;
+
+		// runs the functional model alone to learn how many instructions retire before the spin loop
+		uint64_t count_instructions(const shared_ptr<uint8_t[]>& memory, const unsigned_data exit_address, const size_t program_length)
+		{
+			// loops run at most 8 times, so a program that takes longer than this is a generator bug
+			const uint64_t limit = program_length * 16 + 256;
+			const auto reference_memory = make_shared<UnifiedMemory>(ProgramGenerator::MEMORY_SIZE);
+			memcpy(reference_memory->get_memory_ptr().get(), memory.get(), ProgramGenerator::MEMORY_SIZE);
+			Interpreter interpreter(reference_memory, 0);
+			while (interpreter.get_pc() != exit_address && interpreter.get_instructions_retired() < limit)
+				interpreter.step();
+			return interpreter.get_instructions_retired();
+		}
+
+		vector<inst_data> generate_program(const uint64_t seed, const size_t program_length, shared_ptr<uint8_t[]>& memory)
+		{
+			ProgramGenerator generator(seed);
+			vector<inst_data> code = generator.generate(program_length);
+			memory = generator.build_memory(code);
+			return code;
+		}
+	}
+
+	Fuzzer::Fuzzer(const FuzzConfig& config) : config(config), next_program(0), programs_run(0), instructions_checked(0), stop(false)
+	{
+		if (this->config.threads == 0)
+			this->config.threads = 1;
+	}
+
+	void Fuzzer::run(const uint64_t programs)
+	{
+		stop = false;
+		next_program = 0;
+		vector<thread> workers;
+		for (size_t i = 0; i < config.threads; i++)
+			workers.emplace_back(&Fuzzer::worker, this, programs);
+		for (auto& worker : workers)
+			worker.join();
+	}
+
+	string Fuzzer::run_program(Core& core, const uint64_t seed, const size_t program_length, const uint32_t check_interval, uint64_t& instructions)
+	{
+		shared_ptr<uint8_t[]> memory;
+		const vector<inst_data> code = generate_program(seed, program_length, memory);
+		instructions = count_instructions(memory, ProgramGenerator::get_exit_address(code), program_length) + 1;
+
+		core.load_memory_contents(memory, ProgramGenerator::MEMORY_SIZE);
+		LockstepChecker checker(core, check_interval);
+		if (checker.run(instructions, instructions * max_cycles_per_instruction))
+			return "";
+		if (checker.has_diverged())
+			return checker.describe_divergence();
+		return "pipeline retired " + to_string(checker.get_instructions_checked()) + " of " + to_string(instructions) +
+			" instructions in " + to_string(instructions * max_cycles_per_instruction) + " cycles\n";
+	}
+
+	uint64_t Fuzzer::get_programs_run() const
+	{
+		return programs_run;
+	}
+
+	uint64_t Fuzzer::get_instructions_checked() const
+	{
+		return instructions_checked;
+	}
+
+	vector<FuzzFailure> Fuzzer::get_failures() const
+	{
+		lock_guard lock(failure_mutex);
+		return failures;
+	}
+
+	void Fuzzer::worker(const uint64_t programs)
+	{
+		// one core per thread, loading a program resets it
+		Core core;
+		for (uint64_t program = next_program++; program < programs && !stop; program = next_program++)
+		{
+			const uint64_t seed = config.seed + program;
+			string description;
+			uint64_t instructions = 0;
+			try
+			{
+				description = run_program(core, seed, config.program_length, config.check_interval, instructions);
+			}
+			catch (const exception& error)
+			{
+				description = string("exception: ") + error.what() + '\n';
+			}
+			programs_run++;
+			instructions_checked += instructions;
+
+			if (!description.empty())
+			{
+				shared_ptr<uint8_t[]> memory;
+				lock_guard lock(failure_mutex);
+				failures.push_back({ seed, std::move(description), generate_program(seed, config.program_length, memory) });
+				if (failures.size() >= config.max_failures)
+					stop = true;
+			}
+		}
+	}
+}
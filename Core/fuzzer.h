@@ -0,0 +1,61 @@
+#pragma once
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common.h"
+
+namespace RV32IM
+{
+	class Core;
+
+	struct FuzzConfig
+	{
+		size_t threads = thread::hardware_concurrency();
+		size_t program_length = 256;
+		uint64_t seed = 1;
+		// instructions between lockstep comparisons, see LockstepChecker
+		uint32_t check_interval = 1;
+		size_t max_failures = 16;
+	};
+
+	struct FuzzFailure
+	{
+		uint64_t seed;
+		// one or more lines, each ending in '\n'
+		string description;
+		vector<inst_data> program;
+	};
+
+	// Runs generated programs through the pipeline in lockstep with the functional model on several threads.
+	// Program n uses seed config.seed + n, so any failure can be replayed on its own with run_program.
+	class Fuzzer
+	{
+	public:
+		explicit Fuzzer(const FuzzConfig& config);
+
+		// blocks until the given number of programs ran or max_failures were found
+		void run(uint64_t programs);
+
+		// returns an empty string when the pipeline matched the functional model
+		static string run_program(Core& core, uint64_t seed, size_t program_length, uint32_t check_interval, uint64_t& instructions);
+
+		[[nodiscard]] uint64_t get_programs_run() const;
+		[[nodiscard]] uint64_t get_instructions_checked() const;
+		[[nodiscard]] vector<FuzzFailure> get_failures() const;
+
+	private:
+		void worker(uint64_t programs);
+
+		FuzzConfig config;
+		atomic<uint64_t> next_program;
+		atomic<uint64_t> programs_run;
+		atomic<uint64_t> instructions_checked;
+
+		mutable mutex failure_mutex;
+		vector<FuzzFailure> failures;
+		atomic<bool> stop;
+	};
+}
@@ -0,0 +1,599 @@
+#include "gdb_server.h"
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include <string_view>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "Ws2_32.lib")
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include "core.h"
+
+namespace RV32IM
+{
+	namespace
+	{
+#ifdef _WIN32
+		constexpr SocketHandle invalid_socket = INVALID_SOCKET;
+
+		void close_socket(const SocketHandle socket)
+		{
+			closesocket(socket);
+		}
+
+		bool poll_readable(const SocketHandle socket, const int timeout_ms)
+		{
+			WSAPOLLFD descriptor{ socket, POLLIN, 0 };
+			return WSAPoll(&descriptor, 1, timeout_ms) > 0;
+		}
+#else
+		constexpr SocketHandle invalid_socket = -1;
+
+		void close_socket(const SocketHandle socket)
+		{
+			close(socket);
+		}
+
+		bool poll_readable(const SocketHandle socket, const int timeout_ms)
+		{
+			pollfd descriptor{ socket, POLLIN, 0 };
+			return poll(&descriptor, 1, timeout_ms) > 0;
+		}
+#endif
+
+#ifdef MSG_NOSIGNAL
+		constexpr int send_flags = MSG_NOSIGNAL;
+#else
+		constexpr int send_flags = 0;
+#endif
+
+		constexpr char hex_digits[] = "0123456789abcdef";
+
+		// target description so gdb knows the register layout without being told the architecture
+		string build_target_xml()
+		{
+			stringstream xml;
+			xml << "<?xml version=\"1.0\"?>\n<!DOCTYPE target SYSTEM \"gdb-target.dtd\">\n<target version=\"1.0\">\n"
+				<< "<architecture>riscv:rv32</architecture>\n<feature name=\"org.gnu.gdb.riscv.cpu\">\n";
+			for (int reg = zero; reg < static_cast<int>(RegisterFile::NUM_REGISTERS); reg++)
+			{
+				const char* type = reg == ra ? "code_ptr" : reg == sp || reg == gp || reg == tp ? "data_ptr" : "int";
+				xml << "<reg name=\"" << register_name_to_string[static_cast<RegisterName>(reg)] << "\" bitsize=\"32\" type=\"" << type
+					<< "\" regnum=\"" << reg << "\"/>\n";
+			}
+			xml << "<reg name=\"pc\" bitsize=\"32\" type=\"code_ptr\" regnum=\"32\"/>\n</feature>\n</target>\n";
+			return xml.str();
+		}
+
+		string to_little_endian_hex(const unsigned_data value)
+		{
+			string hex;
+			for (int byte = 0; byte < 4; byte++)
+			{
+				const uint8_t data = value >> (byte * 8) & 0xFF;
+				hex += hex_digits[data >> 4];
+				hex += hex_digits[data & 0xF];
+			}
+			return hex;
+		}
+
+		int hex_value(const char digit)
+		{
+			if (digit >= '0' && digit <= '9')
+				return digit - '0';
+			if (digit >= 'a' && digit <= 'f')
+				return digit - 'a' + 10;
+			if (digit >= 'A' && digit <= 'F')
+				return digit - 'A' + 10;
+			return -1;
+		}
+
+		unsigned_data from_little_endian_hex(const string& hex, const size_t offset)
+		{
+			unsigned_data value = 0;
+			for (int byte = 0; byte < 4 && offset + byte * 2 + 1 < hex.size(); byte++)
+				value |= static_cast<unsigned_data>(hex_value(hex[offset + byte * 2]) << 4 | hex_value(hex[offset + byte * 2 + 1])) << (byte * 8);
+			return value;
+		}
+
+		// parses a big endian hex number from position, leaving position on the first character after it
+		unsigned_data parse_hex(const string& text, size_t& position)
+		{
+			unsigned_data value = 0;
+			while (position < text.size() && hex_value(text[position]) >= 0)
+				value = value << 4 | hex_value(text[position++]);
+			return value;
+		}
+	}
+
+	GdbServer::GdbServer(Core& core, const uint16_t port) :
+		core(core), listen_socket(invalid_socket), client_socket(invalid_socket), port(port), no_ack(false), was_running(false),
+		attached(false), stopping(false)
+	{
+#ifdef _WIN32
+		WSADATA wsa_data;
+		if (WSAStartup(MAKEWORD(2, 2), &wsa_data) != 0)
+			throw GdbServerError("WSAStartup failed");
+#endif
+		listen_socket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+		if (listen_socket == invalid_socket)
+			throw GdbServerError("cannot create socket");
+
+		constexpr int reuse = 1;
+		setsockopt(listen_socket, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+
+		// loopback only, the stub has no authentication
+		sockaddr_in address{};
+		address.sin_family = AF_INET;
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		address.sin_port = htons(port);
+		socklen_t address_size = sizeof(address);
+		if (::bind(listen_socket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listen_socket, 1) != 0 ||
+			getsockname(listen_socket, reinterpret_cast<sockaddr*>(&address), &address_size) != 0)
+		{
+			close_socket(listen_socket);
+			throw GdbServerError("cannot listen on port " + to_string(port));
+		}
+		this->port = ntohs(address.sin_port);
+
+		server_thread = thread(&GdbServer::serve, this);
+	}
+
+	GdbServer::~GdbServer()
+	{
+		stopping = true;
+		if (server_thread.joinable())
+			server_thread.join();
+		close_socket(listen_socket);
+#ifdef _WIN32
+		WSACleanup();
+#endif
+	}
+
+	uint16_t GdbServer::get_port() const
+	{
+		return port;
+	}
+
+	bool GdbServer::is_attached() const
+	{
+		return attached;
+	}
+
+	void GdbServer::serve()
+	{
+		while (!stopping)
+		{
+			// short timeouts keep shutdown responsive without a wakeup socket
+			if (!poll_readable(listen_socket, 100))
+				continue;
+			client_socket = accept(listen_socket, nullptr, nullptr);
+			if (client_socket == invalid_socket)
+				continue;
+
+			constexpr int no_delay = 1;
+			setsockopt(client_socket, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&no_delay), sizeof(no_delay));
+			attached = true;
+			session();
+			close_socket(client_socket);
+			client_socket = invalid_socket;
+			attached = false;
+		}
+	}
+
+	void GdbServer::session()
+	{
+		receive_buffer.clear();
+		no_ack = false;
+		// gdb expects a stopped target when it connects
+		was_running = core.is_clock_running();
+		core.halt();
+
+		string packet;
+		while (receive_packet(packet))
+		{
+			if (!handle_packet(packet))
+				return;
+		}
+		// the debugger went away, leave the program as it was found without its breakpoints
+		end_session(true);
+	}
+
+	bool GdbServer::receive_packet(string& packet)
+	{
+		while (true)
+		{
+			const int start = read_byte();
+			if (start < 0)
+				return false;
+			if (start == 0x03)
+			{
+				packet = "\x03";
+				return true;
+			}
+			if (start != '$')
+				continue;  // acknowledgements
+
+			string data;
+			int character;
+			uint8_t checksum = 0;
+			while ((character = read_byte()) >= 0 && character != '#')
+			{
+				checksum += static_cast<uint8_t>(character);
+				data += static_cast<char>(character);
+			}
+			const int high = read_byte();
+			const int low = read_byte();
+			if (character < 0 || high < 0 || low < 0)
+				return false;
+			if (hex_value(static_cast<char>(high)) << 4 != (checksum & 0xF0) || hex_value(static_cast<char>(low)) != (checksum & 0x0F))
+			{
+				if (!no_ack)
+					send_raw("-");
+				continue;
+			}
+			if (!no_ack)
+				send_raw("+");
+
+			packet.clear();
+			for (size_t i = 0; i < data.size(); i++)
+			{
+				if (data[i] == '}' && i + 1 < data.size())
+					packet += static_cast<char>(data[++i] ^ 0x20);
+				else
+					packet += data[i];
+			}
+			return true;
+		}
+	}
+
+	bool GdbServer::send_packet(const string& data)
+	{
+		uint8_t checksum = 0;
+		for (const char character : data)
+			checksum += static_cast<uint8_t>(character);
+		const string frame = "$" + data + "#" + hex_digits[checksum >> 4] + hex_digits[checksum & 0xF];
+
+		for (int attempt = 0; attempt < 3; attempt++)
+		{
+			if (!send_raw(frame))
+				return false;
+			if (no_ack)
+				return true;
+			const int reply = read_byte();
+			if (reply < 0)
+				return false;
+			if (reply == '+')
+				return true;
+		}
+		return false;
+	}
+
+	bool GdbServer::send_raw(const string& data) const
+	{
+		size_t sent = 0;
+		while (sent < data.size())
+		{
+			const auto result = send(client_socket, data.data() + sent, static_cast<int>(data.size() - sent), send_flags);
+			if (result <= 0)
+				return false;
+			sent += result;
+		}
+		return true;
+	}
+
+	bool GdbServer::wait_readable(const int timeout_ms) const
+	{
+		return !receive_buffer.empty() || poll_readable(client_socket, timeout_ms);
+	}
+
+	int GdbServer::read_byte()
+	{
+		while (receive_buffer.empty())
+		{
+			if (stopping)
+				return -1;
+			if (!poll_readable(client_socket, 100))
+				continue;
+			char chunk[1024];
+			const auto received = recv(client_socket, chunk, sizeof(chunk), 0);
+			if (received <= 0)
+				return -1;
+			receive_buffer.append(chunk, received);
+		}
+		const auto byte = static_cast<uint8_t>(receive_buffer.front());
+		receive_buffer.erase(0, 1);
+		return byte;
+	}
+
+	bool GdbServer::handle_packet(const string& packet)
+	{
+		size_t position = 1;
+		switch (packet[0])
+		{
+		case '?':
+			return send_packet("S05");
+		case 'g':
+			return send_packet(read_registers());
+		case 'G':
+			write_registers(packet.substr(1));
+			return send_packet("OK");
+		case 'p':
+		{
+			const unsigned_data reg = parse_hex(packet, position);
+			if (reg < RegisterFile::NUM_REGISTERS)
+				return send_packet(to_little_endian_hex(reg == zero ? 0 : core.get_registers()[reg]));
+			if (reg == RegisterFile::NUM_REGISTERS)
+				return send_packet(to_little_endian_hex(core.get_current_address()));
+			return send_packet("E01");
+		}
+		case 'P':
+		{
+			const unsigned_data reg = parse_hex(packet, position);
+			const unsigned_data value = from_little_endian_hex(packet, position + 1);
+			if (reg < RegisterFile::NUM_REGISTERS)
+				core.set_register(static_cast<RegisterName>(reg), value);
+			else if (reg == RegisterFile::NUM_REGISTERS)
+				core.set_pc(value);
+			else
+				return send_packet("E01");
+			return send_packet("OK");
+		}
+		case 'm':
+		{
+			const unsigned_data address = parse_hex(packet, position);
+			position++;
+			const size_t length = min<size_t>(parse_hex(packet, position), PACKET_SIZE / 2);
+			return send_packet(read_memory(address, length));
+		}
+		case 'M':
+		{
+			const unsigned_data address = parse_hex(packet, position);
+			const size_t colon = packet.find(':');
+			if (colon == string::npos)
+				return send_packet("E01");
+			write_memory(address, packet.substr(colon + 1));
+			return send_packet("OK");
+		}
+		case 'c':
+		case 's':
+			if (packet.size() > 1)
+				core.set_pc(parse_hex(packet, position));
+			return resume(packet[0] == 's');
+		case 'Z':
+		case 'z':
+			return send_packet(handle_breakpoint(packet, packet[0] == 'Z'));
+		case 'q':
+			return send_packet(handle_query(packet));
+		case 'Q':
+			if (packet == "QStartNoAckMode")
+			{
+				const bool sent = send_packet("OK");
+				no_ack = true;
+				return sent;
+			}
+			return send_packet("");
+		case 'H':
+		case 'T':
+			return send_packet("OK");
+		case 'D':
+			send_packet("OK");
+			end_session(true);
+			return false;
+		case 'k':
+			end_session(false);
+			return false;
+		case 'v':
+			if (packet.rfind("vKill", 0) == 0)
+			{
+				send_packet("OK");
+				end_session(false);
+				return false;
+			}
+			return send_packet("");
+		case 0x03:
+			return true;  // already stopped
+		default:
+			return send_packet("");
+		}
+	}
+
+	bool GdbServer::resume(const bool step)
+	{
+		if (step)
+		{
+			core.step_instruction();
+			return send_packet(stop_reply());
+		}
+
+		core.start_clock();
+		bool interrupted = false;
+		while (core.is_clock_running())
+		{
+			if (stopping)
+				break;
+			if (!wait_readable(10))
+				continue;
+			const int byte = read_byte();
+			if (byte < 0)
+			{
+				core.halt();
+				return false;
+			}
+			if (byte == 0x03)
+			{
+				interrupted = true;
+				break;
+			}
+		}
+		// also settles a core that paused itself at a breakpoint
+		core.halt();
+		return send_packet(interrupted ? "T02" : stop_reply());
+	}
+
+	void GdbServer::end_session(const bool restore_run_state)
+	{
+		for (const unsigned_data pc : breakpoints)
+			core.remove_breakpoint(pc);
+		for (const auto& watchpoint : watchpoints)
+			core.remove_watchpoint(watchpoint.address, watchpoint.size, watchpoint.type);
+		breakpoints.clear();
+		watchpoints.clear();
+		if (restore_run_state && was_running)
+			core.start_clock();
+	}
+
+	string GdbServer::read_registers() const
+	{
+		const auto& registers = core.get_registers();
+		string hex = to_little_endian_hex(0);
+		for (size_t reg = 1; reg < RegisterFile::NUM_REGISTERS; reg++)
+			hex += to_little_endian_hex(registers[reg]);
+		return hex + to_little_endian_hex(core.get_current_address());
+	}
+
+	void GdbServer::write_registers(const string& data)
+	{
+		for (size_t reg = 1; reg < RegisterFile::NUM_REGISTERS && (reg + 1) * 8 <= data.size(); reg++)
+			core.set_register(static_cast<RegisterName>(reg), from_little_endian_hex(data, reg * 8));
+		if (data.size() >= (RegisterFile::NUM_REGISTERS + 1) * 8)
+			core.set_pc(from_little_endian_hex(data, RegisterFile::NUM_REGISTERS * 8));
+	}
+
+	string GdbServer::read_memory(const unsigned_data address, const size_t length) const
+	{
+		const uint8_t* memory = core.get_memory_ptr().get();
+		const size_t mask = core.get_memory_size() - 1;
+		string hex;
+		for (size_t i = 0; i < length; i++)
+		{
+			const uint8_t data = memory[(address + i) & mask];
+			hex += hex_digits[data >> 4];
+			hex += hex_digits[data & 0xF];
+		}
+		return hex;
+	}
+
+	void GdbServer::write_memory(const unsigned_data address, const string& data)
+	{
+		uint8_t* memory = core.get_memory_ptr().get();
+		const size_t mask = core.get_memory_size() - 1;
+		for (size_t i = 0; i + 1 < data.size(); i += 2)
+			memory[(address + i / 2) & mask] = static_cast<uint8_t>(hex_value(data[i]) << 4 | hex_value(data[i + 1]));
+	}
+
+	string GdbServer::handle_breakpoint(const string& packet, const bool insert)
+	{
+		size_t position = 1;
+		const unsigned_data type = parse_hex(packet, position);
+		position++;
+		const unsigned_data address = parse_hex(packet, position);
+		position++;
+		const unsigned_data length = parse_hex(packet, position);
+
+		if (type <= 1)
+		{
+			// gdb may insert the same point again, keep one entry so a single remove clears it
+			if (insert)
+			{
+				core.add_breakpoint(address);
+				if (ranges::find(breakpoints, address) == breakpoints.end())
+					breakpoints.push_back(address);
+			}
+			else
+			{
+				core.remove_breakpoint(address);
+				erase(breakpoints, address);
+			}
+			return "OK";
+		}
+		if (type <= 4)
+		{
+			const WatchType watch_type = type == 2 ? WATCH_WRITE : type == 3 ? WATCH_READ : WATCH_ACCESS;
+			const auto matches = [&](const Watchpoint& watchpoint)
+				{
+					return watchpoint.address == address && watchpoint.size == length && watchpoint.type == watch_type;
+				};
+			if (insert)
+			{
+				if (ranges::find_if(watchpoints, matches) == watchpoints.end())
+				{
+					core.add_watchpoint(address, length, watch_type);
+					watchpoints.push_back({ address, length, watch_type });
+				}
+			}
+			else
+			{
+				core.remove_watchpoint(address, length, watch_type);
+				erase_if(watchpoints, matches);
+			}
+			return "OK";
+		}
+		return "";
+	}
+
+	string GdbServer::handle_query(const string& packet) const
+	{
+		if (packet.rfind("qSupported", 0) == 0)
+		{
+			stringstream features;
+			features << "PacketSize=" << hex << PACKET_SIZE << ";qXfer:features:read+;swbreak+;hwbreak+;QStartNoAckMode+";
+			return features.str();
+		}
+		constexpr string_view features_query = "qXfer:features:read:target.xml:";
+		if (packet.rfind(features_query, 0) == 0)
+		{
+			static const string target_xml = build_target_xml();
+			size_t position = features_query.size();
+			const size_t offset = parse_hex(packet, position);
+			position++;
+			const size_t length = parse_hex(packet, position);
+			if (offset >= target_xml.size())
+				return "l";
+			const string chunk = target_xml.substr(offset, length);
+			return (offset + chunk.size() >= target_xml.size() ? "l" : "m") + chunk;
+		}
+		if (packet == "qAttached")
+			return "1";
+		if (packet == "qC")
+			return "QC1";
+		if (packet == "qfThreadInfo")
+			return "m1";
+		if (packet == "qsThreadInfo")
+			return "l";
+		if (packet == "qOffsets")
+			return "Text=0;Data=0;Bss=0";
+		if (packet.rfind("qSymbol", 0) == 0)
+			return "OK";
+		return "";
+	}
+
+	string GdbServer::stop_reply() const
+	{
+		const StopInfo& stop = core.get_stop_info();
+		switch (stop.reason)
+		{
+		case StopReason::BREAKPOINT:
+			return "T05swbreak:;";
+		case StopReason::WATCHPOINT:
+		{
+			stringstream reply;
+			reply << "T05" << (stop.access == WATCH_READ ? "rwatch:" : "watch:") << hex << stop.address << ";";
+			return reply.str();
+		}
+		default:
+			return "T05";
+		}
+	}
+}
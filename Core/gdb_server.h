@@ -0,0 +1,93 @@
+#pragma once
+#include <atomic>
+#include <exception>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common.h"
+#include "debug_points.h"
+
+namespace RV32IM
+{
+	class Core;
+
+#ifdef _WIN32
+	using SocketHandle = uintptr_t;
+#else
+	using SocketHandle = int;
+#endif
+
+	// GDB remote serial protocol stub on a loopback TCP port. It serves one debugger at a time from its own thread,
+	// the core is only touched while the stub holds it halted at an instruction boundary, and nothing in the
+	// clock loop changes unless the debugger sets breakpoints.
+	// Connect with: gdb-multiarch -ex "set architecture riscv:rv32" -ex "target remote localhost:<port>"
+	class GdbServer
+	{
+	public:
+		static constexpr size_t PACKET_SIZE = 0x4000;
+
+		// port 0 picks a free port, see get_port
+		explicit GdbServer(Core& core, uint16_t port = 3333);
+		~GdbServer();
+
+		GdbServer(const GdbServer&) = delete;
+		GdbServer& operator=(const GdbServer&) = delete;
+
+		[[nodiscard]] uint16_t get_port() const;
+		[[nodiscard]] bool is_attached() const;
+
+	private:
+		void serve();
+		void session();
+
+		bool receive_packet(string& packet);
+		bool send_packet(const string& data);
+		bool send_raw(const string& data) const;
+		bool wait_readable(int timeout_ms) const;
+		int read_byte();
+
+		// returns false once the session should end
+		bool handle_packet(const string& packet);
+		bool resume(bool step);
+		// drops the session's debug points, and restarts the core if it was running when the debugger attached
+		void end_session(bool restore_run_state);
+
+		string read_registers() const;
+		void write_registers(const string& data);
+		string read_memory(unsigned_data address, size_t length) const;
+		void write_memory(unsigned_data address, const string& data);
+		string handle_breakpoint(const string& packet, bool insert);
+		string handle_query(const string& packet) const;
+		string stop_reply() const;
+
+		Core& core;
+		SocketHandle listen_socket;
+		SocketHandle client_socket;
+		uint16_t port;
+
+		string receive_buffer;
+		bool no_ack;
+		bool was_running;
+		vector<unsigned_data> breakpoints;
+		vector<Watchpoint> watchpoints;
+
+		atomic<bool> attached;
+		atomic<bool> stopping;
+		thread server_thread;
+	};
+
+	class GdbServerError : public exception
+	{
+	public:
+		explicit GdbServerError(string message) : message(std::move(message)) {}
+
+		const char* what() const noexcept override
+		{
+			return message.c_str();
+		}
+
+	private:
+		string message;
+	};
+}
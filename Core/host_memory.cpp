@@ -0,0 +1,106 @@
+#include "host_memory.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+namespace RV32IM
+{
+	namespace
+	{
+		size_t round_to_huge_pages(const size_t size)
+		{
+			return (size + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+		}
+
+#ifdef _WIN32
+		void* map_large_pages(const size_t size)
+		{
+			// needs SeLockMemoryPrivilege, without it the call fails and the caller falls back
+			const size_t minimum = GetLargePageMinimum();
+			if (minimum == 0 || size % minimum != 0)
+				return nullptr;
+			return VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+		}
+#else
+		// over-maps by a huge page and trims both ends, so the mapping starts on a 2 MiB boundary
+		void* map_aligned(const size_t size)
+		{
+			void* mapping = mmap(nullptr, size + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (mapping == MAP_FAILED)
+				return nullptr;
+			const auto start = reinterpret_cast<uintptr_t>(mapping);
+			const uintptr_t aligned = (start + HUGE_PAGE_SIZE - 1) & ~static_cast<uintptr_t>(HUGE_PAGE_SIZE - 1);
+			if (aligned > start)
+				munmap(mapping, aligned - start);
+			if (const uintptr_t tail = start + size + HUGE_PAGE_SIZE - (aligned + size); tail > 0)
+				munmap(reinterpret_cast<void*>(aligned + size), tail);
+			return reinterpret_cast<void*>(aligned);
+		}
+#endif
+	}
+
+	void* map_huge_pages(size_t size, const PageBacking backing, PageBacking& granted)
+	{
+		size = round_to_huge_pages(size);
+#ifdef _WIN32
+		// Windows has no transparent huge pages, large pages are always explicit
+		if (backing == PageBacking::EXPLICIT)
+		{
+			if (void* pointer = map_large_pages(size))
+			{
+				granted = PageBacking::EXPLICIT;
+				return pointer;
+			}
+		}
+		granted = PageBacking::NORMAL;
+		return VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+#ifdef MAP_HUGETLB
+		if (backing == PageBacking::EXPLICIT)
+		{
+			void* pointer = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+			if (pointer != MAP_FAILED)
+			{
+				granted = PageBacking::EXPLICIT;
+				return pointer;
+			}
+		}
+#endif
+		void* pointer = map_aligned(size);
+		granted = PageBacking::NORMAL;
+#ifdef MADV_HUGEPAGE
+		if (pointer && backing != PageBacking::NORMAL && madvise(pointer, size, MADV_HUGEPAGE) == 0)
+			granted = PageBacking::TRANSPARENT;
+#endif
+		return pointer;
+#endif
+	}
+
+	void unmap_huge_pages(void* pointer, const size_t size)
+	{
+#ifdef _WIN32
+		(void)size;
+		VirtualFree(pointer, 0, MEM_RELEASE);
+#else
+		munmap(pointer, round_to_huge_pages(size));
+#endif
+	}
+
+	HostBuffer allocate_host_memory(const size_t size, const PageBacking backing)
+	{
+		if (backing == PageBacking::NORMAL)
+			return { shared_ptr<uint8_t[]>(new uint8_t[size]{}), PageBacking::NORMAL };
+
+		// fresh anonymous mappings are already zero
+		PageBacking granted;
+		auto* pointer = static_cast<uint8_t*>(map_huge_pages(size, backing, granted));
+		if (!pointer)
+			return { shared_ptr<uint8_t[]>(new uint8_t[size]{}), PageBacking::NORMAL };
+		return { shared_ptr<uint8_t[]>(pointer, [size](const uint8_t* mapping) { unmap_huge_pages(const_cast<uint8_t*>(mapping), size); }),
+			granted };
+	}
+}
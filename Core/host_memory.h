@@ -0,0 +1,83 @@
+#pragma once
+#include <memory>
+#include <new>
+#include <vector>
+
+#include "common.h"
+
+namespace RV32IM
+{
+	static constexpr size_t HUGE_PAGE_SIZE = 0x200000;
+
+	// how the host memory behind guest RAM and large predictor tables is backed
+	enum class PageBacking
+	{
+		NORMAL,			// regular pages from the heap
+		TRANSPARENT,	// 2 MiB aligned and advised as huge page candidates, the kernel promotes them when it can
+		EXPLICIT		// taken from the reserved huge page pool, falls back to TRANSPARENT when the pool is empty, on Windows to NORMAL
+	};
+
+	struct HostBuffer
+	{
+		shared_ptr<uint8_t[]> data;
+		// what was actually granted, at most what was asked for
+		PageBacking backing;
+	};
+
+	// zero filled, huge page backed buffers start on a 2 MiB boundary so guest address masking lines up with the pages
+	HostBuffer allocate_host_memory(size_t size, PageBacking backing);
+
+	// raw mappings for HostBuffer and HugePageAllocator, the size is rounded up to whole huge pages on both calls
+	void* map_huge_pages(size_t size, PageBacking backing, PageBacking& granted);
+	void unmap_huge_pages(void* pointer, size_t size);
+
+	// allocations of at least one huge page are mapped with the given backing, smaller ones and NORMAL come from the heap
+	template <typename T>
+	class HugePageAllocator
+	{
+	public:
+		using value_type = T;
+		// a table assigned from one built with another backing keeps that backing
+		using propagate_on_container_copy_assignment = true_type;
+		using propagate_on_container_move_assignment = true_type;
+		using propagate_on_container_swap = true_type;
+
+		HugePageAllocator(const PageBacking backing = PageBacking::NORMAL) : backing(backing) {}
+		template <typename U>
+		HugePageAllocator(const HugePageAllocator<U>& other) : backing(other.get_backing()) {}
+
+		T* allocate(const size_t count)
+		{
+			const size_t size = count * sizeof(T);
+			if (!is_mapped(size))
+				return static_cast<T*>(::operator new(size));
+			PageBacking granted;
+			void* pointer = map_huge_pages(size, backing, granted);
+			if (!pointer)
+				throw bad_alloc();
+			return static_cast<T*>(pointer);
+		}
+
+		void deallocate(T* pointer, const size_t count)
+		{
+			const size_t size = count * sizeof(T);
+			if (!is_mapped(size))
+				::operator delete(pointer);
+			else
+				unmap_huge_pages(pointer, size);
+		}
+
+		[[nodiscard]] PageBacking get_backing() const { return backing; }
+
+		template <typename U>
+		bool operator==(const HugePageAllocator<U>& other) const { return backing == other.get_backing(); }
+
+	private:
+		[[nodiscard]] bool is_mapped(const size_t size) const { return backing != PageBacking::NORMAL && size >= HUGE_PAGE_SIZE; }
+
+		PageBacking backing;
+	};
+
+	template <typename T>
+	using HugePageVector = vector<T, HugePageAllocator<T>>;
+}
@@ -7,98 +7,91 @@ namespace RV32IM
 	Instruction::Instruction(const inst_data& instruction_data): opcode(RI), rs1(zero), rs2(zero), rd(zero), funct3(), funct7(),
 	                                                             immediate(0),
 	                                                             inst(instruction_data),
-	                                                             type()
+	                                                             type(),
+	                                                             operation(Operation::ADD),
+	                                                             bubble(true),
+	                                                             length(4)
 	{
 	}
 
-	bool Instruction::has_rs1() const
-	{
-		return type == InstructionFormat::R ||
-			   type == InstructionFormat::I ||
-			   type == InstructionFormat::S ||
-			   type == InstructionFormat::B;
-	}
-
-	bool Instruction::has_rs2() const
-	{
-		return type == InstructionFormat::R ||
-			   type == InstructionFormat::S ||
-			   type == InstructionFormat::B;
-	}
-
 	InstructionR::InstructionR(const inst_data& instruction_data)
 	{
-		opcode = static_cast<Opcodes>(mask_data(instruction_data, 0, 6));
-		rd = static_cast<RegisterName>(mask_data(instruction_data, 7, 11));
-		funct3 = static_cast<Funct3>(mask_data(instruction_data, 12, 14));
-		rs1 = static_cast<RegisterName>(mask_data(instruction_data, 15, 19));
-		rs2 = static_cast<RegisterName>(mask_data(instruction_data, 20, 24));
-		funct7 = static_cast<Funct7>(mask_data(instruction_data, 25, 31));
+		opcode = decode_opcode(instruction_data);
+		rd = decode_rd(instruction_data);
+		funct3 = decode_funct3(instruction_data);
+		rs1 = decode_rs1(instruction_data);
+		rs2 = decode_rs2(instruction_data);
+		funct7 = decode_funct7(instruction_data);
 		type = InstructionFormat::R;
+		operation = decode_operation(instruction_data);
 		inst = instruction_data;
+		bubble = false;
 	}
 
 	InstructionI::InstructionI(const inst_data& instruction_data)
 	{
-		opcode = static_cast<Opcodes>(mask_data(instruction_data, 0, 6));
-		rd = static_cast<RegisterName>(mask_data(instruction_data, 7, 11));
-		funct3 = static_cast<Funct3>(mask_data(instruction_data, 12, 14));
-		rs1 = static_cast<RegisterName>(mask_data(instruction_data, 15, 19));
-		immediate = mask_data(instruction_data, 20, 30) | 
-					sign_extend(mask_data(instruction_data, 31, 31), 11);
+		opcode = decode_opcode(instruction_data);
+		rd = decode_rd(instruction_data);
+		funct3 = decode_funct3(instruction_data);
+		rs1 = decode_rs1(instruction_data);
+		immediate = immediate_i(instruction_data);
 		type = InstructionFormat::I;
+		operation = decode_operation(instruction_data);
 		inst = instruction_data;
+		bubble = false;
 	}
 
 	InstructionS::InstructionS(const inst_data& instruction_data)
 	{
-		opcode = static_cast<Opcodes>(mask_data(instruction_data, 0, 6));
-		funct3 = static_cast<Funct3>(mask_data(instruction_data, 12, 14));
-		rs1 = static_cast<RegisterName>(mask_data(instruction_data, 15, 19));
-		rs2 = static_cast<RegisterName>(mask_data(instruction_data, 20, 24));
-		immediate = mask_data(instruction_data, 7, 11) |
-					mask_data(instruction_data, 25, 30) << 5 |
-					sign_extend(mask_data(instruction_data, 31, 31), 11);
+		opcode = decode_opcode(instruction_data);
+		funct3 = decode_funct3(instruction_data);
+		rs1 = decode_rs1(instruction_data);
+		rs2 = decode_rs2(instruction_data);
+		immediate = immediate_s(instruction_data);
 		type = InstructionFormat::S;
+		operation = decode_operation(instruction_data);
 		inst = instruction_data;
+		bubble = false;
 	}
 
 	InstructionB::InstructionB(const inst_data& instruction_data)
 	{
-		opcode = static_cast<Opcodes>(mask_data(instruction_data, 0, 6));
-		funct3 = static_cast<Funct3>(mask_data(instruction_data, 12, 14));
-		rs1 = static_cast<RegisterName>(mask_data(instruction_data, 15, 19));
-		rs2 = static_cast<RegisterName>(mask_data(instruction_data, 20, 24));
-		immediate = mask_data(instruction_data, 8, 11) << 1 |
-					mask_data(instruction_data, 25, 30) << 5 |
-					mask_data(instruction_data, 7, 7) << 11 |
-					sign_extend(mask_data(instruction_data, 31, 31), 12);
+		opcode = decode_opcode(instruction_data);
+		funct3 = decode_funct3(instruction_data);
+		rs1 = decode_rs1(instruction_data);
+		rs2 = decode_rs2(instruction_data);
+		immediate = immediate_b(instruction_data);
 		type = InstructionFormat::B;
+		operation = decode_operation(instruction_data);
 		inst = instruction_data;
+		bubble = false;
 	}
 
 	InstructionU::InstructionU(const inst_data& instruction_data)
 	{
-		opcode = static_cast<Opcodes>(mask_data(instruction_data, 0, 6));
-		rd = static_cast<RegisterName>(mask_data(instruction_data, 7, 11));
-		immediate = mask_data(instruction_data, 12, 19) << 12 |
-					mask_data(instruction_data, 20, 30) << 20 |
-					mask_data(instruction_data, 31, 31) << 31;
+		opcode = decode_opcode(instruction_data);
+		rd = decode_rd(instruction_data);
+		immediate = immediate_u(instruction_data);
 		type = InstructionFormat::U;
+		operation = decode_operation(instruction_data);
 		inst = instruction_data;
+		bubble = false;
 	}
 
 	InstructionJ::InstructionJ(const inst_data& instruction_data)
 	{
-		opcode = static_cast<Opcodes>(mask_data(instruction_data, 0, 6));
-		rd = static_cast<RegisterName>(mask_data(instruction_data, 7, 11));
-		immediate = mask_data(instruction_data, 21, 30) << 1 |
-					mask_data(instruction_data, 20, 20) << 11 |
-					mask_data(instruction_data, 12, 19) << 12 |
-					sign_extend(mask_data(instruction_data, 31, 31), 20);
+		opcode = decode_opcode(instruction_data);
+		rd = decode_rd(instruction_data);
+		immediate = immediate_j(instruction_data);
 		type = InstructionFormat::J;
+		operation = decode_operation(instruction_data);
 		inst = instruction_data;
+		bubble = false;
 	}
 
-	InstructionNOP::InstructionNOP(): InstructionI(0x00000013) {}
+	InstructionNOP::InstructionNOP(): InstructionI(0x00000013)
+	{
+		// generated by the pipeline rather than fetched, so it never retires
+		bubble = true;
+	}
 }
@@ -1,5 +1,6 @@
 #pragma once
 #include "common.h"
+#include "decode_tables.h"
 
 namespace RV32IM
 {
@@ -16,9 +17,15 @@ namespace RV32IM
 		unsigned_data immediate;
 		inst_data inst;
 		InstructionFormat type;
+		Operation operation;
+		bool bubble;
+		// 2 for RVC encodings, which are expanded into the fields above and inst
+		uint8_t length;
 
-		bool has_rs1() const;
-		bool has_rs2() const;
+		// the immediate CSR forms keep their uimm in the rs1 field, so they read no register
+		bool has_rs1() const { return get_operand_usage(type) & USES_RS1 && !(opcode == Opcodes::SYSTEM && funct3 >= CSRRWI); }
+		bool has_rs2() const { return get_operand_usage(type) & USES_RS2; }
+		bool has_rd() const { return get_operand_usage(type) & WRITES_RD; }
 	};
 
 	struct InstructionR : Instruction
@@ -0,0 +1,341 @@
+#include "interpreter.h"
+
+#include "fetch.h"
+
+namespace RV32IM
+{
+	Interpreter::Interpreter(shared_ptr<UnifiedMemory> memory, const unsigned_data entry_point) :
+		memory(std::move(memory)), registers(), pc(entry_point), instructions_retired(0), reservation()
+	{
+	}
+
+	TraceRecord Interpreter::step()
+	{
+		Instruction instruction = Stage::Fetch::parse_instruction(Stage::Fetch::read_instruction(*memory, pc));
+		while (instruction.bubble)
+		{
+			pc += instruction.length;
+			instruction = Stage::Fetch::parse_instruction(Stage::Fetch::read_instruction(*memory, pc));
+		}
+
+		TraceRecord record = make_record(instruction);
+		execute(instruction, record);
+		return record;
+	}
+
+	TraceRecord Interpreter::make_record(const Instruction& instruction) const
+	{
+		return { pc, instruction.inst, 0, 0, 0, static_cast<uint8_t>(instruction.length == 2 ? TRACE_COMPRESSED : 0) };
+	}
+
+	void Interpreter::execute(const Instruction& instruction, TraceRecord& record)
+	{
+		const unsigned_data rs1 = registers[instruction.rs1];
+		const unsigned_data rs2 = registers[instruction.rs2];
+		unsigned_data rd_value = 0;
+		unsigned_data next_pc = pc + instruction.length;
+
+		switch (instruction.opcode)
+		{
+		case Opcodes::RR:
+			rd_value = compute(instruction, rs1, rs2);
+			break;
+		case Opcodes::RI:
+			rd_value = compute(instruction, rs1, instruction.immediate);
+			break;
+		case Opcodes::LUI:
+			rd_value = instruction.immediate;
+			break;
+		case Opcodes::AUIPC:
+			rd_value = pc + instruction.immediate;
+			break;
+		case Opcodes::LX:
+			record.flags |= TRACE_LOAD;
+			record.memory_address = rs1 + instruction.immediate;
+			rd_value = Stage::Memory::load(*memory, instruction.funct3, record.memory_address);
+			record.memory_data = rd_value;
+			break;
+		case Opcodes::SX:
+			record.flags |= TRACE_STORE;
+			record.memory_address = rs1 + instruction.immediate;
+			record.memory_data = rs2;
+			Stage::Memory::store(*memory, instruction.funct3, record.memory_address, rs2);
+			break;
+		case Opcodes::AMO:
+			record.flags |= atomic_trace_flags(instruction.inst);
+			record.memory_address = rs1;
+			rd_value = Stage::Memory::atomic(*memory, instruction, rs1, rs2, reservation);
+			record.memory_data = instruction.inst >> 27 == LR_W ? rd_value : rs2;
+			break;
+		case Opcodes::BXX:
+			if (take_branch(instruction.funct3, rs1, rs2))
+				next_pc = pc + instruction.immediate;
+			break;
+		case Opcodes::JAL:
+			next_pc = pc + instruction.immediate;
+			rd_value = pc + instruction.length;
+			break;
+		case Opcodes::JALR:
+			next_pc = (rs1 + instruction.immediate) & ~1u;
+			rd_value = pc + instruction.length;
+			break;
+		case Opcodes::SYSTEM:
+			// counters only exist in the pipeline, the checker copies the value it read
+			break;
+		}
+
+		if (instruction.has_rd() && instruction.rd != zero)
+		{
+			registers[instruction.rd] = rd_value;
+			record.flags |= TRACE_RD;
+			record.rd_value = rd_value;
+		}
+		pc = next_pc;
+		instructions_retired++;
+	}
+
+	uint64_t Interpreter::run(const uint64_t instructions)
+	{
+		if (predecoded.empty())
+			// an odd pc never matches, so every slot starts empty
+			predecoded.resize(PREDECODE_ENTRIES, PredecodedEntry{ 1, 0, 0, Instruction(), Instruction(), Fusion::NONE, 0, 0 });
+
+		const uint64_t end = instructions_retired + instructions;
+		uint64_t dispatches = 0;
+		while (instructions_retired < end)
+		{
+			const PredecodedEntry& entry = predecode(pc);
+			dispatches++;
+			if (entry.first.bubble)
+			{
+				pc += entry.first.length;
+				continue;
+			}
+			// a pair may not straddle the requested count
+			if (entry.fusion != Fusion::NONE && end - instructions_retired >= 2)
+			{
+				execute_fused(entry);
+				continue;
+			}
+			TraceRecord record = make_record(entry.first);
+			execute(entry.first, record);
+		}
+		return dispatches;
+	}
+
+	void Interpreter::execute_fused(const PredecodedEntry& entry)
+	{
+		const Instruction& first = entry.first;
+		const Instruction& second = entry.second;
+		switch (entry.fusion)
+		{
+		case Fusion::LOAD_CONSTANT:
+			registers[second.rd] = entry.value;
+			pc += first.length + second.length;
+			break;
+		case Fusion::CALL:
+			registers[first.rd] = entry.value;
+			if (second.rd != zero)
+				registers[second.rd] = pc + first.length + second.length;
+			pc = entry.target;
+			break;
+		case Fusion::SCALED_ADD:
+			registers[first.rd] = registers[first.rs1] << (first.immediate & 0x1F);
+			if (second.rd != zero)
+				registers[second.rd] = registers[second.rs1] + registers[second.rs2];
+			pc += first.length + second.length;
+			break;
+		case Fusion::COMPARE_BRANCH:
+			registers[first.rd] = compute(first, registers[first.rs1], first.type == InstructionFormat::I ? first.immediate : registers[first.rs2]);
+			pc = take_branch(second.funct3, registers[second.rs1], registers[second.rs2]) ?
+				pc + first.length + second.immediate : pc + first.length + second.length;
+			break;
+		case Fusion::LOAD_BRANCH:
+			registers[first.rd] = Stage::Memory::load(*memory, first.funct3, registers[first.rs1] + first.immediate);
+			pc = take_branch(second.funct3, registers[second.rs1], registers[second.rs2]) ?
+				pc + first.length + second.immediate : pc + first.length + second.length;
+			break;
+		case Fusion::NONE:
+			break;
+		}
+		instructions_retired += 2;
+	}
+
+	const Interpreter::PredecodedEntry& Interpreter::predecode(const unsigned_data address)
+	{
+		PredecodedEntry& entry = predecoded[address >> 1 & (PREDECODE_ENTRIES - 1)];
+		const inst_data data = Stage::Fetch::read_instruction(*memory, address);
+		if (entry.pc == address && entry.data == data && (entry.fusion == Fusion::NONE ||
+			Stage::Fetch::read_instruction(*memory, address + entry.first.length) == entry.next_data))
+			return entry;
+
+		entry.pc = address;
+		entry.data = data;
+		entry.first = Stage::Fetch::parse_instruction(data);
+		entry.fusion = Fusion::NONE;
+		if (entry.first.bubble)
+			return entry;
+		entry.next_data = Stage::Fetch::read_instruction(*memory, address + entry.first.length);
+		entry.second = Stage::Fetch::parse_instruction(entry.next_data);
+		entry.fusion = find_fusion(entry.first, entry.second);
+		const unsigned_data upper = entry.first.immediate + (entry.first.operation == Operation::AUIPC ? address : 0);
+		if (entry.fusion == Fusion::LOAD_CONSTANT)
+			entry.value = upper + entry.second.immediate;
+		else if (entry.fusion == Fusion::CALL)
+		{
+			entry.value = upper;
+			entry.target = (upper + entry.second.immediate) & ~1u;
+		}
+		return entry;
+	}
+
+	Interpreter::Fusion Interpreter::find_fusion(const Instruction& first, const Instruction& second)
+	{
+		if (second.bubble || first.rd == zero)
+			return Fusion::NONE;
+		const RegisterName result = first.rd;
+		const bool is_addi = second.operation == Operation::ADD && second.type == InstructionFormat::I;
+
+		switch (first.operation)
+		{
+		case Operation::LUI:
+		case Operation::AUIPC:
+			if (is_addi && second.rs1 == result && second.rd == result)
+				return Fusion::LOAD_CONSTANT;
+			if (first.operation == Operation::AUIPC && second.operation == Operation::JALR && second.rs1 == result)
+				return Fusion::CALL;
+			return Fusion::NONE;
+		case Operation::SLL:
+			if (first.type == InstructionFormat::I && second.operation == Operation::ADD && second.type == InstructionFormat::R &&
+				(second.rs1 == result || second.rs2 == result))
+				return Fusion::SCALED_ADD;
+			return Fusion::NONE;
+		case Operation::ADD:
+			if (first.type != InstructionFormat::I)
+				return Fusion::NONE;
+			[[fallthrough]];
+		case Operation::SLT:
+		case Operation::SLTU:
+			if (second.type == InstructionFormat::B && (second.rs1 == result || second.rs2 == result))
+				return Fusion::COMPARE_BRANCH;
+			return Fusion::NONE;
+		case Operation::LB:
+		case Operation::LH:
+		case Operation::LW:
+		case Operation::LBU:
+		case Operation::LHU:
+			if (second.type == InstructionFormat::B && (second.rs1 == result || second.rs2 == result))
+				return Fusion::LOAD_BRANCH;
+			return Fusion::NONE;
+		default:
+			return Fusion::NONE;
+		}
+	}
+
+	unsigned_data Interpreter::compute(const Instruction& instruction, const unsigned_data a, const unsigned_data b)
+	{
+		// written from the ISA manual rather than shared with the ALU, so the fuzzer can catch arithmetic bugs
+		const auto signed_a = static_cast<int64_t>(static_cast<signed_data>(a));
+		const auto signed_b = static_cast<int64_t>(static_cast<signed_data>(b));
+		const bool alternate = instruction.inst >> 30 & 1;
+		const unsigned_data shift = b & 0x1F;
+
+		if (instruction.opcode == Opcodes::RR && instruction.funct7 == M_EXT)
+		{
+			switch (instruction.funct3)
+			{
+			case MUL:
+				return static_cast<unsigned_data>(signed_a * signed_b);
+			case MULH:
+				return static_cast<unsigned_data>(signed_a * signed_b >> 32);
+			case MULHSU:
+				return static_cast<unsigned_data>(signed_a * static_cast<int64_t>(b) >> 32);
+			case MULHU:
+				return static_cast<unsigned_data>(static_cast<uint64_t>(a) * b >> 32);
+			case DIV:
+				if (b == 0)
+					return 0xFFFFFFFF;
+				return static_cast<unsigned_data>(signed_a / signed_b);
+			case DIVU:
+				return b == 0 ? 0xFFFFFFFF : a / b;
+			case REM:
+				if (b == 0)
+					return a;
+				return static_cast<unsigned_data>(signed_a % signed_b);
+			case REMU:
+				return b == 0 ? a : a % b;
+			default:
+				return 0;
+			}
+		}
+
+		switch (instruction.funct3)
+		{
+		case ADD:
+			return instruction.opcode == Opcodes::RR && alternate ? a - b : a + b;
+		case SLL:
+			return a << shift;
+		case SLT:
+			return signed_a < signed_b;
+		case SLTU:
+			return a < b;
+		case XOR:
+			return a ^ b;
+		case SRL:
+			return alternate ? static_cast<unsigned_data>(static_cast<signed_data>(a) >> shift) : a >> shift;
+		case OR:
+			return a | b;
+		case AND:
+			return a & b;
+		default:
+			return 0;
+		}
+	}
+
+	bool Interpreter::take_branch(const Funct3 funct3, const unsigned_data a, const unsigned_data b)
+	{
+		switch (funct3)
+		{
+		case BEQ:
+			return a == b;
+		case BNE:
+			return a != b;
+		case BLT:
+			return static_cast<signed_data>(a) < static_cast<signed_data>(b);
+		case BGE:
+			return static_cast<signed_data>(a) >= static_cast<signed_data>(b);
+		case BLTU:
+			return a < b;
+		case BGEU:
+			return a >= b;
+		default:
+			return false;
+		}
+	}
+
+	void Interpreter::set_register(const RegisterName reg, const unsigned_data value)
+	{
+		if (reg != zero)
+			registers[reg] = value;
+	}
+
+	void Interpreter::set_pc(const unsigned_data new_pc)
+	{
+		pc = new_pc;
+	}
+
+	const array<unsigned_data, RegisterFile::NUM_REGISTERS>& Interpreter::get_registers() const
+	{
+		return registers;
+	}
+
+	unsigned_data Interpreter::get_pc() const
+	{
+		return pc;
+	}
+
+	uint64_t Interpreter::get_instructions_retired() const
+	{
+		return instructions_retired;
+	}
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include <array>
+#include <memory>
+#include <vector>
+
+#include "common.h"
+#include "instruction.h"
+#include "memory.h"
+#include "register_file.h"
+#include "trace.h"
+#include "unified_memory.h"
+
+namespace RV32IM
+{
+	// Functional model: executes one instruction per step with no pipeline timing.
+	// Used as the reference the pipeline is checked against. It shares the decoder and memory access helpers,
+	// but computes results on its own.
+	class Interpreter
+	{
+	public:
+		Interpreter(shared_ptr<UnifiedMemory> memory, unsigned_data entry_point);
+
+		// executes up to the next retired instruction and describes it, invalid encodings retire nothing like in the pipeline
+		TraceRecord step();
+		// executes the given number of retired instructions without describing them, fusing common pairs into one
+		// dispatch, and returns the dispatch count, which run() alone counts
+		uint64_t run(uint64_t instructions);
+
+		void set_register(RegisterName reg, unsigned_data value);
+		void set_pc(unsigned_data new_pc);
+
+		[[nodiscard]] const array<unsigned_data, RegisterFile::NUM_REGISTERS>& get_registers() const;
+		[[nodiscard]] unsigned_data get_pc() const;
+		[[nodiscard]] uint64_t get_instructions_retired() const;
+
+	private:
+		// pairs that compilers emit back to back, the second instruction consumes the first's result
+		enum class Fusion : uint8_t
+		{
+			NONE,
+			LOAD_CONSTANT,	// lui+addi or auipc+addi into the same register, the sum is known at decode
+			CALL,			// auipc+jalr through the same register, a far call or jump with a known target
+			SCALED_ADD,		// slli+add, indexing an array
+			COMPARE_BRANCH,	// addi, slt(i) or sltu(i) feeding the next branch, loop counters and bound checks
+			LOAD_BRANCH		// a load tested by the next branch, scanning strings and lists
+		};
+
+		struct PredecodedEntry
+		{
+			// raw halfwords or words at pc and after the first instruction, checked on every hit so stores to code are seen
+			unsigned_data pc;
+			inst_data data;
+			inst_data next_data;
+			Instruction first;
+			Instruction second;
+			Fusion fusion;
+			// first's result for LOAD_CONSTANT and CALL, and the jump target for CALL
+			unsigned_data value;
+			unsigned_data target;
+		};
+
+		static constexpr size_t PREDECODE_ENTRIES = 4096;
+
+		// the record step() would return for instruction at pc, before execute() fills in its results
+		[[nodiscard]] TraceRecord make_record(const Instruction& instruction) const;
+		void execute(const Instruction& instruction, TraceRecord& record);
+		void execute_fused(const PredecodedEntry& entry);
+		const PredecodedEntry& predecode(unsigned_data address);
+		static Fusion find_fusion(const Instruction& first, const Instruction& second);
+		static unsigned_data compute(const Instruction& instruction, unsigned_data a, unsigned_data b);
+		static bool take_branch(Funct3 funct3, unsigned_data a, unsigned_data b);
+
+		shared_ptr<UnifiedMemory> memory;
+		array<unsigned_data, RegisterFile::NUM_REGISTERS> registers;
+		unsigned_data pc;
+		uint64_t instructions_retired;
+		Reservation reservation;
+		// direct mapped by halfword address, built on the first run()
+		vector<PredecodedEntry> predecoded;
+	};
+}
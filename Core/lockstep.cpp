@@ -0,0 +1,216 @@
+#include "lockstep.h"
+
+#include <cstring>
+#include <sstream>
+
+#include "core.h"
+
+namespace RV32IM
+{
+	namespace
+	{
+		shared_ptr<UnifiedMemory> copy_memory(const Core& core)
+		{
+			auto memory = make_shared<UnifiedMemory>(core.get_memory_size());
+			memcpy(memory->get_memory_ptr().get(), core.get_memory_ptr().get(), core.get_memory_size());
+			return memory;
+		}
+
+		bool operator==(const TraceRecord& left, const TraceRecord& right)
+		{
+			return left.pc == right.pc && left.inst == right.inst && left.flags == right.flags &&
+				left.rd_value == right.rd_value && left.memory_address == right.memory_address && left.memory_data == right.memory_data;
+		}
+	}
+
+	LockstepChecker::LockstepChecker(Core& core, const uint32_t check_interval) :
+		core(core),
+		interpreter(copy_memory(core), core.fetch->get_next_PC()),
+		check_interval(check_interval == 0 ? 1 : check_interval),
+		pipeline_hash(0),
+		reference_hash(0),
+		context(),
+		context_head(0),
+		context_count(0),
+		instructions_checked(0),
+		diverged(false),
+		divergence()
+	{
+		pipeline_window.reserve(this->check_interval);
+		reference_window.reserve(this->check_interval);
+		core.lockstep = this;
+	}
+
+	LockstepChecker::~LockstepChecker()
+	{
+		if (core.lockstep == this)
+			core.lockstep = nullptr;
+	}
+
+	bool LockstepChecker::run(const uint64_t instructions, const uint64_t max_cycles)
+	{
+		const uint64_t target = instructions_checked + instructions;
+		for (uint64_t cycle = 0; cycle < max_cycles && !diverged; cycle++)
+		{
+			core.clock();
+			// register writes land when the register file is clocked, so compare them after the cycle
+			if (pipeline_window.size() >= check_interval)
+				check_window();
+			if (instructions_checked + pipeline_window.size() >= target)
+				break;
+		}
+		if (!diverged && !pipeline_window.empty())
+			check_window();
+		return !diverged && instructions_checked >= target;
+	}
+
+	void LockstepChecker::on_retire(const TraceRecord& record)
+	{
+		if (diverged)
+			return;
+
+		TraceRecord reference = interpreter.step();
+		// counters only exist in the pipeline, so take its value for CSR reads
+		if ((record.inst & 0x7F) == Opcodes::SYSTEM && record.pc == reference.pc && (record.flags & TRACE_RD))
+		{
+			reference.rd_value = record.rd_value;
+			interpreter.set_register(static_cast<RegisterName>((record.inst >> 7) & 0x1F), record.rd_value);
+		}
+
+		pipeline_window.push_back(record);
+		reference_window.push_back(reference);
+		if (check_interval == 1)
+			return;
+		pipeline_hash = hash_record(pipeline_hash, record);
+		reference_hash = hash_record(reference_hash, reference);
+	}
+
+	void LockstepChecker::check_window()
+	{
+		if (check_interval == 1 || pipeline_hash != reference_hash)
+		{
+			for (size_t i = 0; i < pipeline_window.size(); i++)
+			{
+				if (!(pipeline_window[i] == reference_window[i]))
+				{
+					const TraceRecord& pipeline = pipeline_window[i];
+					const TraceRecord& reference = reference_window[i];
+					if (pipeline.pc != reference.pc)
+						report(i, "PC differs");
+					else if (pipeline.inst != reference.inst)
+						report(i, "instruction word differs");
+					else if (pipeline.memory_address != reference.memory_address)
+						report(i, "memory address differs");
+					else if ((pipeline.flags & TRACE_STORE) && pipeline.memory_data != reference.memory_data)
+						report(i, "store data differs");
+					else
+						report(i, "rd value differs");
+					return;
+				}
+			}
+		}
+
+		for (const auto& record : pipeline_window)
+			push_context(record);
+		instructions_checked += pipeline_window.size();
+		pipeline_window.clear();
+		reference_window.clear();
+		check_registers();
+	}
+
+	void LockstepChecker::check_registers()
+	{
+		const auto& pipeline = core.get_registers();
+		const auto& reference = interpreter.get_registers();
+		for (size_t reg = 1; reg < RegisterFile::NUM_REGISTERS; reg++)
+		{
+			if (pipeline[reg] != reference[reg])
+			{
+				diverged = true;
+				divergence.instruction = instructions_checked;
+				divergence.reason = "register " + register_name_to_string[static_cast<RegisterName>(reg)] + " differs: pipeline " +
+					to_hex(pipeline[reg]) + ", reference " + to_hex(reference[reg]);
+				divergence.pipeline = divergence.reference = context[(context_head + CONTEXT_SIZE - 1) % CONTEXT_SIZE];
+				divergence.context.clear();
+				for (size_t i = context_count; i > 0; i--)
+					divergence.context.push_back(context[(context_head + CONTEXT_SIZE - i) % CONTEXT_SIZE]);
+				return;
+			}
+		}
+	}
+
+	void LockstepChecker::report(const size_t window_index, string reason)
+	{
+		for (size_t i = 0; i < window_index; i++)
+			push_context(pipeline_window[i]);
+
+		diverged = true;
+		divergence.instruction = instructions_checked + window_index;
+		divergence.reason = std::move(reason);
+		divergence.pipeline = pipeline_window[window_index];
+		divergence.reference = reference_window[window_index];
+		divergence.context.clear();
+		for (size_t i = context_count; i > 0; i--)
+			divergence.context.push_back(context[(context_head + CONTEXT_SIZE - i) % CONTEXT_SIZE]);
+	}
+
+	void LockstepChecker::push_context(const TraceRecord& record)
+	{
+		context[context_head] = record;
+		context_head = (context_head + 1) % CONTEXT_SIZE;
+		if (context_count < CONTEXT_SIZE)
+			context_count++;
+	}
+
+	bool LockstepChecker::has_diverged() const
+	{
+		return diverged;
+	}
+
+	const LockstepDivergence& LockstepChecker::get_divergence() const
+	{
+		return divergence;
+	}
+
+	uint64_t LockstepChecker::get_instructions_checked() const
+	{
+		return instructions_checked;
+	}
+
+	string LockstepChecker::describe_divergence() const
+	{
+		if (!diverged)
+			return "no divergence after " + to_string(instructions_checked) + " instructions";
+
+		const SymbolTable& symbols = core.get_symbols();
+		stringstream output;
+		output << "divergence at instruction " << divergence.instruction << ": " << divergence.reason << '\n';
+		for (const auto& record : divergence.context)
+			output << "          " << symbols.describe(record.pc) << "  " << describe_record(record) << '\n';
+		output << "pipeline  " << symbols.describe(divergence.pipeline.pc) << "  " << describe_record(divergence.pipeline) << '\n';
+		output << "reference " << symbols.describe(divergence.reference.pc) << "  " << describe_record(divergence.reference) << '\n';
+		return output.str();
+	}
+
+	uint64_t LockstepChecker::hash_record(uint64_t hash, const TraceRecord& record)
+	{
+		// FNV-1a over the fields, enough to catch any difference in a window
+		constexpr uint64_t prime = 0x100000001B3;
+		for (const uint32_t field : { record.pc, record.inst, record.rd_value, record.memory_address, record.memory_data,
+		                              static_cast<uint32_t>(record.flags) })
+			hash = (hash ^ field) * prime;
+		return hash;
+	}
+
+	string LockstepChecker::describe_record(const TraceRecord& record)
+	{
+		string description = to_hex(record.inst);
+		if (record.flags & TRACE_RD)
+			description += " rd=" + to_hex(record.rd_value);
+		if (record.flags & TRACE_LOAD)
+			description += " load[" + to_hex(record.memory_address) + "]=" + to_hex(record.memory_data);
+		if (record.flags & TRACE_STORE)
+			description += " store[" + to_hex(record.memory_address) + "]=" + to_hex(record.memory_data);
+		return description;
+	}
+}
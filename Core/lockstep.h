@@ -0,0 +1,76 @@
+#pragma once
+#include <array>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "common.h"
+#include "interpreter.h"
+#include "trace.h"
+
+namespace RV32IM
+{
+	class Core;
+
+	struct LockstepDivergence
+	{
+		uint64_t instruction;		// index of the first retired instruction that differs
+		string reason;
+		TraceRecord pipeline;
+		TraceRecord reference;
+		vector<TraceRecord> context;	// instructions both engines agreed on just before the divergence, oldest first
+	};
+
+	// Runs the pipeline and the functional model side by side and stops at the first retired instruction they disagree on.
+	// With an interval of 1 every record and the register file are compared after each retirement,
+	// larger intervals fold the records into rolling hashes and only compare those and the register file every N instructions.
+	// Attach right after loading or resetting the core, before it has been clocked.
+	class LockstepChecker
+	{
+	public:
+		static constexpr size_t CONTEXT_SIZE = 16;
+
+		explicit LockstepChecker(Core& core, uint32_t check_interval = 1);
+		~LockstepChecker();
+
+		LockstepChecker(const LockstepChecker&) = delete;
+		LockstepChecker& operator=(const LockstepChecker&) = delete;
+
+		// clocks the pipeline until the given number of instructions retired, returns false on divergence or timeout
+		bool run(uint64_t instructions, uint64_t max_cycles);
+
+		void on_retire(const TraceRecord& record);
+
+		[[nodiscard]] bool has_diverged() const;
+		[[nodiscard]] const LockstepDivergence& get_divergence() const;
+		[[nodiscard]] uint64_t get_instructions_checked() const;
+		[[nodiscard]] string describe_divergence() const;
+
+	private:
+		void check_window();
+		void check_registers();
+		void report(size_t window_index, string reason);
+		void push_context(const TraceRecord& record);
+
+		static uint64_t hash_record(uint64_t hash, const TraceRecord& record);
+		static string describe_record(const TraceRecord& record);
+
+		Core& core;
+		Interpreter interpreter;
+		uint32_t check_interval;
+
+		// records retired since the last check, kept to locate the divergence when the hashes differ
+		vector<TraceRecord> pipeline_window;
+		vector<TraceRecord> reference_window;
+		uint64_t pipeline_hash;
+		uint64_t reference_hash;
+
+		array<TraceRecord, CONTEXT_SIZE> context;
+		size_t context_head;
+		size_t context_count;
+
+		uint64_t instructions_checked;
+		bool diverged;
+		LockstepDivergence divergence;
+	};
+}
@@ -7,7 +7,17 @@ namespace RV32IM
 {
 	namespace Stage
 	{
-		Memory::Memory(Core* main_core): BaseStage(main_core) {}
+		Memory::Memory(Core* main_core): BaseStage(main_core), reservation() {}
+
+		void Memory::reset()
+		{
+			reg_instruction.reset();
+			reg_alu.reset();
+			reg_mem_in.reset();
+			reg_PC.reset();
+			reg_rs2.reset();
+			reservation = {};
+		}
 
 		void Memory::clock()
 		{
@@ -15,6 +25,7 @@ namespace RV32IM
 			reg_alu.clock();
 			reg_mem_in.clock();
 			reg_PC.clock();
+			reg_rs2.clock();
 		}
 
 		void Memory::run()
@@ -27,50 +38,114 @@ namespace RV32IM
 			reg_alu = alu_result;
 			reg_PC = pc;
 
+			if (core->caches)
+			{
+				// an AMO reads and writes its word, only LR leaves the line clean
+				if (instruction.opcode == Opcodes::LX || (instruction.opcode == Opcodes::AMO && instruction.inst >> 27 == LR_W))
+					core->caches->load(alu_result);
+				else if (instruction.opcode == Opcodes::SX || instruction.opcode == Opcodes::AMO)
+					core->caches->store(alu_result);
+			}
+
 			if (instruction.opcode == Opcodes::SX)
 			{
 				const unsigned_data rs2 = core->execute->reg_rs2;
-				switch (instruction.funct3)
-				{
-				case SW:
-					core->memory->write_word(alu_result, rs2);
-					break;
-				case SH:
-					core->memory->write_half_word(alu_result, static_cast<uint16_t>(rs2));
-					break;
-				case SB:
-					core->memory->write_byte(alu_result, static_cast<uint8_t>(rs2));
-					break;
-				default:
-					break;
-				}
+				reg_rs2 = rs2;
+				store(*core->memory, instruction.funct3, alu_result, rs2);
 			}
 
 			if (instruction.opcode == Opcodes::LX)
+				reg_mem_in = load(*core->memory, instruction.funct3, alu_result);
+
+			if (instruction.opcode == Opcodes::AMO)
+			{
+				const unsigned_data rs2 = core->execute->reg_rs2;
+				reg_rs2 = rs2;
+				reg_mem_in = atomic(*core->memory, instruction, alu_result, rs2, reservation);
+			}
+		}
+
+		unsigned_data Memory::load(const UnifiedMemory& memory, const Funct3 funct3, const unsigned_data address)
+		{
+			switch (funct3)
+			{
+			case LB:
+				return static_cast<int8_t>(memory.read_byte(address));
+			case LH:
+				return static_cast<int16_t>(memory.read_half_word(address));
+			case LW:
+				return memory.read_word(address);
+			case LBU:
+				return memory.read_byte(address);
+			case LHU:
+				return memory.read_half_word(address);
+			default:
+				return 0xFFFFFFFF;
+			}
+		}
+
+		unsigned_data Memory::atomic(const UnifiedMemory& memory, const Instruction& instruction, const unsigned_data address,
+			const unsigned_data data, Reservation& reservation)
+		{
+			// sequentially consistent throughout, which satisfies any combination of the aq/rl bits
+			const auto word = memory.atomic_word(address);
+			const auto select = [&](const auto pick)
+			{
+				unsigned_data old_value = word.load();
+				while (!word.compare_exchange_weak(old_value, pick(old_value))) {}
+				return old_value;
+			};
+
+			switch (instruction.inst >> 27)
+			{
+			case LR_W:
+				reservation = { address, word.load(), true };
+				return reservation.value;
+			case SC_W:
+			{
+				unsigned_data expected = reservation.value;
+				const bool success = reservation.valid && reservation.address == address && word.compare_exchange_strong(expected, data);
+				reservation.valid = false;
+				return success ? 0 : 1;
+			}
+			case AMOSWAP_W:
+				return word.exchange(data);
+			case AMOADD_W:
+				return word.fetch_add(data);
+			case AMOXOR_W:
+				return word.fetch_xor(data);
+			case AMOAND_W:
+				return word.fetch_and(data);
+			case AMOOR_W:
+				return word.fetch_or(data);
+			case AMOMIN_W:
+				return select([&](const unsigned_data value) { return static_cast<signed_data>(value) < static_cast<signed_data>(data) ? value : data; });
+			case AMOMAX_W:
+				return select([&](const unsigned_data value) { return static_cast<signed_data>(value) > static_cast<signed_data>(data) ? value : data; });
+			case AMOMINU_W:
+				return select([&](const unsigned_data value) { return value < data ? value : data; });
+			case AMOMAXU_W:
+				return select([&](const unsigned_data value) { return value > data ? value : data; });
+			default:
+				return 0xFFFFFFFF;
+			}
+		}
+
+		void Memory::store(const UnifiedMemory& memory, const Funct3 funct3, const unsigned_data address, const unsigned_data data)
+		{
+			switch (funct3)
 			{
-				unsigned_data memory_in;
-				switch (instruction.funct3)
-				{
-				case LB:
-					memory_in = static_cast<int8_t>(core->memory->read_byte(alu_result));
-					break;
-				case LH:
-					memory_in = static_cast<int16_t>(core->memory->read_half_word(alu_result));
-					break;
-				case LW:
-					memory_in = core->memory->read_word(alu_result);
-					break;
-				case LBU:
-					memory_in = core->memory->read_byte(alu_result);
-					break;
-				case LHU:
-					memory_in = core->memory->read_half_word(alu_result);
-					break;
-				default:
-					memory_in = 0xFFFFFFFF;
-					break;
-				}
-				reg_mem_in = memory_in;
+			case SW:
+				memory.write_word(address, data);
+				break;
+			case SH:
+				memory.write_half_word(address, static_cast<uint16_t>(data));
+				break;
+			case SB:
+				memory.write_byte(address, static_cast<uint8_t>(data));
+				break;
+			default:
+				break;
 			}
 		}
 	}
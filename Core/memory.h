@@ -3,14 +3,25 @@
 #include "common.h"
 #include "instruction.h"
 #include "register.h"
+#include "unified_memory.h"
 
 namespace RV32IM
 {
+	// LR/SC reservation of one hart. A store conditional succeeds if the word still holds the value the reserving load saw,
+	// which is how a compare and swap host implements it without tracking other harts' stores.
+	struct Reservation
+	{
+		unsigned_data address;
+		unsigned_data value;
+		bool valid;
+	};
+
 	namespace Stage
 	{
 		class Memory : virtual public BaseStage
 		{
 		public:
+			friend class RV32IM::Core;
 			friend class Fetch;
 			friend class Decode;
 			friend class Execute;
@@ -19,12 +30,22 @@ namespace RV32IM
 			Memory(Core* core);
 			void clock() override;
 			void run() override;
+			void reset() override;
+
+			// shared with the functional model so both engines agree on sub-word and invalid accesses
+			static unsigned_data load(const UnifiedMemory& memory, Funct3 funct3, unsigned_data address);
+			static void store(const UnifiedMemory& memory, Funct3 funct3, unsigned_data address, unsigned_data data);
+			// performs an A extension instruction with host atomics and returns the value for rd
+			static unsigned_data atomic(const UnifiedMemory& memory, const Instruction& instruction, unsigned_data address, unsigned_data data,
+				Reservation& reservation);
 
 		private:
 			Register<Instruction> reg_instruction;
 			Register<unsigned_data> reg_alu;
 			Register<unsigned_data> reg_mem_in;
 			Register<unsigned_data> reg_PC;
+			Register<unsigned_data> reg_rs2;
+			Reservation reservation;
 		};
 	}
 }
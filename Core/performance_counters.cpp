@@ -0,0 +1,84 @@
+#include "performance_counters.h"
+
+namespace RV32IM
+{
+	PerformanceCounters::PerformanceCounters() : cycles(0), instructions_retired(0), stalls(0), mispredicts(0),
+	                                             bubbles(0), start_time(chrono::steady_clock::now())
+	{
+	}
+
+	void PerformanceCounters::reset()
+	{
+		cycles = 0;
+		instructions_retired = 0;
+		stalls = 0;
+		mispredicts = 0;
+		bubbles = 0;
+		start_time = chrono::steady_clock::now();
+	}
+
+	unsigned_data PerformanceCounters::read_csr(const unsigned_data csr) const
+	{
+		// counters are 64 bits wide, the H variants return the upper word
+		switch (csr)
+		{
+		case CYCLE:
+			return static_cast<unsigned_data>(cycles);
+		case CYCLEH:
+			return static_cast<unsigned_data>(cycles >> 32);
+		case TIME:
+			return static_cast<unsigned_data>(get_time());
+		case TIMEH:
+			return static_cast<unsigned_data>(get_time() >> 32);
+		case INSTRET:
+			return static_cast<unsigned_data>(instructions_retired);
+		case INSTRETH:
+			return static_cast<unsigned_data>(instructions_retired >> 32);
+		case HPM_STALL:
+			return static_cast<unsigned_data>(stalls);
+		case HPM_STALLH:
+			return static_cast<unsigned_data>(stalls >> 32);
+		case HPM_MISPREDICT:
+			return static_cast<unsigned_data>(mispredicts);
+		case HPM_MISPREDICTH:
+			return static_cast<unsigned_data>(mispredicts >> 32);
+		case HPM_BUBBLE:
+			return static_cast<unsigned_data>(bubbles);
+		case HPM_BUBBLEH:
+			return static_cast<unsigned_data>(bubbles >> 32);
+		default:
+			return 0;
+		}
+	}
+
+	uint64_t PerformanceCounters::get_cycles() const
+	{
+		return cycles;
+	}
+
+	uint64_t PerformanceCounters::get_time() const
+	{
+		// time ticks once per microsecond of host time since reset
+		return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start_time).count();
+	}
+
+	uint64_t PerformanceCounters::get_instructions_retired() const
+	{
+		return instructions_retired;
+	}
+
+	uint64_t PerformanceCounters::get_stalls() const
+	{
+		return stalls;
+	}
+
+	uint64_t PerformanceCounters::get_mispredicts() const
+	{
+		return mispredicts;
+	}
+
+	uint64_t PerformanceCounters::get_bubbles() const
+	{
+		return bubbles;
+	}
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <chrono>
+
+#include "common.h"
+
+namespace RV32IM
+{
+	class PerformanceCounters
+	{
+	public:
+		PerformanceCounters();
+
+		void count_cycle() { cycles++; }
+		void count_retired() { instructions_retired++; }
+		void count_stall() { stalls++; }
+		void count_mispredict() { mispredicts++; }
+		void count_bubble() { bubbles++; }
+		// zeroes the counters and restarts the time CSR
+		void reset();
+
+		[[nodiscard]] unsigned_data read_csr(unsigned_data csr) const;
+
+		[[nodiscard]] uint64_t get_cycles() const;
+		[[nodiscard]] uint64_t get_time() const;
+		[[nodiscard]] uint64_t get_instructions_retired() const;
+		[[nodiscard]] uint64_t get_stalls() const;
+		[[nodiscard]] uint64_t get_mispredicts() const;
+		[[nodiscard]] uint64_t get_bubbles() const;
+
+	private:
+		uint64_t cycles;
+		uint64_t instructions_retired;
+		uint64_t stalls;
+		uint64_t mispredicts;
+		uint64_t bubbles;
+		chrono::time_point<chrono::steady_clock> start_time;
+	};
+}
@@ -0,0 +1,100 @@
+#include "profiler.h"
+
+#include <algorithm>
+
+#include "fetch.h"
+
+namespace RV32IM
+{
+	Profiler::Profiler() : call_nodes{ CallNode{ 0, 0, 0 } }, current_node(0) {}
+
+	void Profiler::record_retired(const unsigned_data pc, const Instruction& instruction, const unsigned_data target)
+	{
+		flat_profile[pc].instructions++;
+		call_nodes[current_node].instructions++;
+
+		// same hints the return address stack follows: a jump through a different link register returns,
+		// a jump that writes a link register calls, and a jump doing both is a coroutine swap
+		if (instruction.opcode == Opcodes::JALR && Stage::Fetch::is_link_register(instruction.rs1) && instruction.rs1 != instruction.rd)
+			current_node = call_nodes[current_node].parent;
+
+		if ((instruction.opcode == Opcodes::JAL || instruction.opcode == Opcodes::JALR) && Stage::Fetch::is_link_register(instruction.rd))
+		{
+			size_t& child = call_edges[static_cast<uint64_t>(current_node) << 32 | target];
+			if (child == 0)
+			{
+				child = call_nodes.size();
+				call_nodes.push_back(CallNode{ target, current_node, 0 });
+			}
+			current_node = child;
+		}
+	}
+
+	void Profiler::record_stall(const unsigned_data pc)
+	{
+		flat_profile[pc].stall_cycles++;
+	}
+
+	void Profiler::record_mispredict(const unsigned_data pc)
+	{
+		flat_profile[pc].mispredicts++;
+	}
+
+	void Profiler::reset()
+	{
+		flat_profile.clear();
+		call_edges.clear();
+		call_nodes = { CallNode{ 0, 0, 0 } };
+		current_node = 0;
+	}
+
+	const AddressMap<unsigned_data, ProfileEntry>& Profiler::get_flat_profile() const
+	{
+		return flat_profile;
+	}
+
+	void Profiler::write_flat(ostream& output, const SymbolTable* symbols) const
+	{
+		vector<pair<unsigned_data, ProfileEntry>> entries;
+		entries.reserve(flat_profile.size());
+		flat_profile.for_each([&entries](const unsigned_data pc, const ProfileEntry& entry)
+			{
+				entries.emplace_back(pc, entry);
+			});
+		ranges::sort(entries, [](const auto& a, const auto& b) { return a.second.instructions > b.second.instructions; });
+
+		output << "address instructions stall_cycles mispredicts" << (symbols ? " symbol\n" : "\n");
+		for (const auto& [pc, entry] : entries)
+		{
+			output << to_hex(pc) << ' ' << entry.instructions << ' ' << entry.stall_cycles << ' ' << entry.mispredicts;
+			if (symbols)
+				output << ' ' << symbols->describe(pc);
+			output << '\n';
+		}
+	}
+
+	void Profiler::write_folded(ostream& output, const SymbolTable* symbols) const
+	{
+		for (size_t node{ 0 }; node < call_nodes.size(); node++)
+		{
+			if (call_nodes[node].instructions > 0)
+				output << get_stack(node, symbols) << ' ' << call_nodes[node].instructions << '\n';
+		}
+	}
+
+	string Profiler::get_stack(size_t node, const SymbolTable* symbols) const
+	{
+		// walk to the root and emit outermost frame first
+		vector<unsigned_data> frames;
+		while (node != 0)
+		{
+			frames.push_back(call_nodes[node].function);
+			node = call_nodes[node].parent;
+		}
+
+		string stack = "root";
+		for (auto frame = frames.rbegin(); frame != frames.rend(); ++frame)
+			stack += ';' + (symbols ? symbols->describe(*frame) : to_hex(*frame));
+		return stack;
+	}
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <ostream>
+#include <vector>
+
+#include "address_map.h"
+#include "common.h"
+#include "instruction.h"
+#include "symbol_table.h"
+
+namespace RV32IM
+{
+	struct ProfileEntry
+	{
+		uint64_t instructions;
+		uint64_t stall_cycles;
+		uint64_t mispredicts;
+	};
+
+	// counts retired instructions, stalls and mispredicts per PC and per call stack
+	class Profiler
+	{
+	public:
+		Profiler();
+
+		void record_retired(unsigned_data pc, const Instruction& instruction, unsigned_data target);
+		void record_stall(unsigned_data pc);
+		void record_mispredict(unsigned_data pc);
+		void reset();
+
+		[[nodiscard]] const AddressMap<unsigned_data, ProfileEntry>& get_flat_profile() const;
+
+		// one line per PC: address, instructions, stall cycles, mispredicts
+		void write_flat(ostream& output, const SymbolTable* symbols = nullptr) const;
+		// one line per call stack in the folded format read by flamegraph.pl and speedscope
+		void write_folded(ostream& output, const SymbolTable* symbols = nullptr) const;
+
+	private:
+		struct CallNode
+		{
+			unsigned_data function;
+			size_t parent;
+			uint64_t instructions;
+		};
+
+		[[nodiscard]] string get_stack(size_t node, const SymbolTable* symbols) const;
+
+		AddressMap<unsigned_data, ProfileEntry> flat_profile;
+		vector<CallNode> call_nodes;
+		// (parent node << 32 | function) -> child node
+		AddressMap<uint64_t, size_t> call_edges;
+		size_t current_node;
+	};
+}
@@ -0,0 +1,386 @@
+#include "program_generator.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "instruction.h"
+
+namespace RV32IM
+{
+	namespace
+	{
+		constexpr RegisterName base_register = s0;
+		constexpr RegisterName scratch_register = s1;
+		constexpr RegisterName loop_register = t2;
+		constexpr RegisterName atomic_register = s2;
+
+		struct Encoding
+		{
+			Opcodes opcode;
+			Funct3 funct3;
+			Funct7 funct7;
+		};
+
+		// every register/register and register/immediate operation the ALU implements
+		constexpr Encoding alu_encodings[] =
+		{
+			{ RR, ADD, NORM }, { RR, SUB, INV }, { RR, SLL, NORM }, { RR, SLT, NORM }, { RR, SLTU, NORM },
+			{ RR, XOR, NORM }, { RR, SRL, NORM }, { RR, SRA, INV }, { RR, OR, NORM }, { RR, AND, NORM },
+			{ RR, MUL, M_EXT }, { RR, MULH, M_EXT }, { RR, MULHSU, M_EXT }, { RR, MULHU, M_EXT },
+			{ RR, DIV, M_EXT }, { RR, DIVU, M_EXT }, { RR, REM, M_EXT }, { RR, REMU, M_EXT },
+			{ RI, ADD, NORM }, { RI, SLL, NORM }, { RI, SLT, NORM }, { RI, SLTU, NORM }, { RI, XOR, NORM },
+			{ RI, SRL, NORM }, { RI, SRA, INV }, { RI, OR, NORM }, { RI, AND, NORM }
+		};
+		constexpr Funct3 load_encodings[] = { LB, LH, LW, LBU, LHU };
+		constexpr Funct3 store_encodings[] = { SB, SH, SW };
+		constexpr Funct3 branch_encodings[] = { BEQ, BNE, BLT, BGE, BLTU, BGEU };
+		constexpr Funct3 csr_encodings[] = { CSRRW, CSRRS, CSRRC, CSRRWI, CSRRSI, CSRRCI };
+		constexpr AtomicFunct5 atomic_encodings[] =
+		{
+			AMOSWAP_W, AMOADD_W, AMOXOR_W, AMOAND_W, AMOOR_W, AMOMIN_W, AMOMAX_W, AMOMINU_W, AMOMAXU_W, SC_W
+		};
+		constexpr CSRAddress csr_addresses[] = { CYCLE, INSTRET, HPM_STALL, HPM_MISPREDICT, HPM_BUBBLE, CYCLEH, INSTRETH };
+
+		// values around the corners of signed and unsigned arithmetic, including the DIV/REM special cases
+		constexpr unsigned_data edge_values[] =
+		{
+			0x00000000, 0x00000001, 0x00000002, 0xFFFFFFFF, 0xFFFFFFFE, 0x80000000, 0x7FFFFFFF, 0x80000001, 0x0000001F, 0x00000020
+		};
+
+		inst_data encode_r(const Encoding encoding, const RegisterName rd, const RegisterName rs1, const RegisterName rs2)
+		{
+			return encoding.funct7 << 25 | rs2 << 20 | rs1 << 15 | encoding.funct3 << 12 | rd << 7 | encoding.opcode;
+		}
+
+		inst_data encode_atomic(const AtomicFunct5 funct5, const RegisterName rd, const RegisterName rs1, const RegisterName rs2)
+		{
+			return funct5 << 27 | rs2 << 20 | rs1 << 15 | LW << 12 | rd << 7 | AMO;
+		}
+
+		inst_data encode_i(const Opcodes opcode, const Funct3 funct3, const RegisterName rd, const RegisterName rs1, const unsigned_data immediate)
+		{
+			return (immediate & 0xFFF) << 20 | rs1 << 15 | funct3 << 12 | rd << 7 | opcode;
+		}
+
+		inst_data encode_s(const Funct3 funct3, const RegisterName rs1, const RegisterName rs2, const unsigned_data immediate)
+		{
+			return (immediate >> 5 & 0x7F) << 25 | rs2 << 20 | rs1 << 15 | funct3 << 12 | (immediate & 0x1F) << 7 | SX;
+		}
+
+		inst_data encode_b(const Funct3 funct3, const RegisterName rs1, const RegisterName rs2, const unsigned_data offset)
+		{
+			return (offset >> 12 & 0x1) << 31 | (offset >> 5 & 0x3F) << 25 | rs2 << 20 | rs1 << 15 | funct3 << 12 |
+				(offset >> 1 & 0xF) << 8 | (offset >> 11 & 0x1) << 7 | BXX;
+		}
+
+		inst_data encode_u(const Opcodes opcode, const RegisterName rd, const unsigned_data immediate)
+		{
+			return (immediate & 0xFFFFF000) | rd << 7 | opcode;
+		}
+
+		inst_data encode_j(const RegisterName rd, const unsigned_data offset)
+		{
+			return (offset >> 20 & 0x1) << 31 | (offset >> 1 & 0x3FF) << 21 | (offset >> 11 & 0x1) << 20 |
+				(offset >> 12 & 0xFF) << 12 | rd << 7 | JAL;
+		}
+
+		// RVC branch and jump offsets scatter their bits, see expand_compressed
+		uint16_t encode_cb(const uint16_t funct3, const RegisterName rs1, const unsigned_data offset)
+		{
+			return static_cast<uint16_t>(funct3 << 13 | (offset >> 8 & 0x1) << 12 | (offset >> 3 & 0x3) << 10 | (rs1 - 8) << 7 |
+				(offset >> 6 & 0x3) << 5 | (offset >> 1 & 0x3) << 3 | (offset >> 5 & 0x1) << 2 | 0x1);
+		}
+
+		uint16_t encode_cj(const uint16_t funct3, const unsigned_data offset)
+		{
+			return static_cast<uint16_t>(funct3 << 13 | (offset >> 11 & 0x1) << 12 | (offset >> 4 & 0x1) << 11 | (offset >> 8 & 0x3) << 9 |
+				(offset >> 10 & 0x1) << 8 | (offset >> 6 & 0x1) << 7 | (offset >> 7 & 0x1) << 6 | (offset >> 1 & 0x7) << 3 |
+				(offset >> 5 & 0x1) << 2 | 0x1);
+		}
+
+		void emit_constant(vector<inst_data>& code, const RegisterName rd, const unsigned_data value)
+		{
+			// addi sign extends, so round the upper part to compensate
+			code.push_back(encode_u(LUI, rd, value + 0x800));
+			code.push_back(encode_i(RI, ADD, rd, rd, value));
+		}
+	}
+
+	ProgramGenerator::ProgramGenerator(const uint64_t seed) : random(seed), recent{ a0, a1, a2, a3 }, recent_head(0) {}
+
+	vector<inst_data> ProgramGenerator::generate(const size_t length)
+	{
+		vector<inst_data> code;
+		code.reserve(length + 80);
+		blocked_words.clear();
+		forward_jumps.clear();
+		emit_prologue(code);
+
+		const size_t end = code.size() + length;
+		while (code.size() < end)
+		{
+			if (uniform(0, 31) == 0 && end - code.size() > 12)
+				emit_loop(code, end - code.size());
+			else
+				emit_random(code, end - code.size(), false);
+		}
+
+		// forward jumps may land anywhere in the padding before the spin loop
+		for (int i = 0; i < 8; i++)
+			code.push_back(encode_i(RI, ADD, zero, zero, 0));
+		code.push_back(encode_j(zero, 0));
+		retarget_blocked_words(code);
+		return code;
+	}
+
+	shared_ptr<uint8_t[]> ProgramGenerator::build_memory(const vector<inst_data>& code)
+	{
+		auto memory = shared_ptr<uint8_t[]>(new uint8_t[MEMORY_SIZE]{});
+		memcpy(memory.get(), code.data(), code.size() * sizeof(inst_data));
+		for (size_t address = DATA_BASE - 0x800; address < MEMORY_SIZE - 0x1000; address += sizeof(uint64_t))
+		{
+			const uint64_t value = random();
+			memcpy(memory.get() + address, &value, sizeof(value));
+		}
+		return memory;
+	}
+
+	unsigned_data ProgramGenerator::get_exit_address(const vector<inst_data>& code)
+	{
+		return static_cast<unsigned_data>((code.size() - 1) * sizeof(inst_data));
+	}
+
+	void ProgramGenerator::emit_prologue(vector<inst_data>& code)
+	{
+		emit_constant(code, base_register, DATA_BASE);
+		emit_constant(code, atomic_register, DATA_BASE);
+		for (int reg = ra; reg < 32; reg++)
+		{
+			if (reg != base_register && reg != scratch_register && reg != loop_register && reg != atomic_register)
+				emit_constant(code, static_cast<RegisterName>(reg), pick_value());
+		}
+	}
+
+	void ProgramGenerator::emit_random(vector<inst_data>& code, const size_t remaining, const bool in_loop)
+	{
+		const uint32_t kind = uniform(0, 16);
+		const RegisterName rd = pick_destination();
+		// forward targets never skip past the end of the padding
+		const uint32_t max_skip = static_cast<uint32_t>(min<size_t>(remaining, 8));
+
+		if (kind < 6)
+		{
+			code.push_back(pick_alu(rd));
+		}
+		else if (kind == 6)
+		{
+			// an RVC instruction, a 32 bit one on a halfword boundary and another RVC instruction fill two words,
+			// the RVC branches skip to the next word and nothing may land on the second one
+			const inst_data middle = pick_alu(rd);
+			code.push_back(pick_compressed(8) | (middle & 0xFFFF) << 16);
+			blocked_words.push_back(code.size());
+			code.push_back(middle >> 16 | static_cast<inst_data>(pick_compressed(2)) << 16);
+		}
+		else if (kind < 9)
+		{
+			code.push_back(encode_i(LX, load_encodings[uniform(0, size(load_encodings) - 1)], rd, base_register, uniform(0, 0xFFF)));
+		}
+		else if (kind < 11)
+		{
+			const unsigned_data offset = uniform(0, 0xFFF);
+			code.push_back(encode_s(store_encodings[uniform(0, size(store_encodings) - 1)], base_register, pick_source(), offset));
+			// reading the location straight back checks store to load ordering
+			if (uniform(0, 1))
+				code.push_back(encode_i(LX, LW, rd, base_register, offset & ~3u));
+		}
+		else if (kind < 13)
+		{
+			const uint32_t skip = uniform(1, max_skip);
+			forward_jumps.emplace_back(code.size(), code.size() + skip);
+			code.push_back(encode_b(branch_encodings[uniform(0, size(branch_encodings) - 1)], pick_source(), pick_source(), skip * 4));
+		}
+		else if (kind == 13)
+		{
+			code.push_back(encode_u(uniform(0, 1) ? LUI : AUIPC, rd, uniform(0, 0xFFFFF) << 12));
+		}
+		else if (kind == 14 && !in_loop)
+		{
+			// jumps out of a loop body would skip the counter update, so loops only branch
+			if (uniform(0, 1))
+			{
+				const uint32_t skip = uniform(1, max_skip);
+				forward_jumps.emplace_back(code.size(), code.size() + skip);
+				code.push_back(encode_j(uniform(0, 1) ? ra : rd, skip * 4));
+			}
+			else
+			{
+				// the offset is relative to the AUIPC
+				const uint32_t skip = uniform(1, max_skip) + 1;
+				code.push_back(encode_u(AUIPC, scratch_register, 0));
+				forward_jumps.emplace_back(code.size(), code.size() - 1 + skip);
+				blocked_words.push_back(code.size());
+				code.push_back(encode_i(JALR, ADD, uniform(0, 1) ? t0 : rd, scratch_register, skip * 4));
+			}
+		}
+		else if (kind == 16)
+		{
+			// atomics take the address from rs1 alone, so point a register of their own at an aligned data word
+			code.push_back(encode_i(RI, ADD, atomic_register, base_register, uniform(0, 0x7FF) & ~3u));
+			if (uniform(0, 1))
+			{
+				// a reservation then a store conditional, which fails when a forward jump lands between the two
+				code.push_back(encode_atomic(LR_W, rd, atomic_register, zero));
+				code.push_back(encode_atomic(SC_W, pick_destination(), atomic_register, pick_source()));
+			}
+			else
+				code.push_back(encode_atomic(atomic_encodings[uniform(0, size(atomic_encodings) - 1)], rd, atomic_register, pick_source()));
+		}
+		else
+		{
+			const Funct3 funct3 = csr_encodings[uniform(0, size(csr_encodings) - 1)];
+			code.push_back(encode_i(SYSTEM, funct3, rd, funct3 >= CSRRWI ? static_cast<RegisterName>(uniform(0, 31)) : pick_source(),
+				csr_addresses[uniform(0, size(csr_addresses) - 1)]));
+		}
+
+		if (rd != zero)
+		{
+			recent[recent_head] = rd;
+			recent_head = (recent_head + 1) % size(recent);
+		}
+	}
+
+	void ProgramGenerator::emit_loop(vector<inst_data>& code, const size_t remaining)
+	{
+		const size_t body = uniform(2, static_cast<uint32_t>(min<size_t>(remaining - 4, 12)));
+		code.push_back(encode_i(RI, ADD, loop_register, zero, uniform(1, 8)));
+		const size_t start = code.size();
+		while (code.size() - start < body)
+			emit_random(code, body - (code.size() - start), true);
+		code.push_back(encode_i(RI, ADD, loop_register, loop_register, 0xFFF));
+		// a forward jump into the body finds the counter at or below zero and falls out after one pass
+		code.push_back(encode_b(BLT, zero, loop_register, static_cast<unsigned_data>(-static_cast<int32_t>((code.size() - start) * 4))));
+	}
+
+	void ProgramGenerator::retarget_blocked_words(vector<inst_data>& code) const
+	{
+		// a jump onto a blocked word moves on until it reaches one that starts an instruction with a known s1
+		for (const auto& [source, target] : forward_jumps)
+		{
+			unsigned_data extra = 0;
+			while (ranges::binary_search(blocked_words, target + extra / 4))
+				extra += 4;
+			if (extra == 0)
+				continue;
+			const inst_data word = code[source];
+			switch (word & 0x7F)
+			{
+			case BXX:
+			{
+				const InstructionB branch(word);
+				code[source] = encode_b(branch.funct3, branch.rs1, branch.rs2, branch.immediate + extra);
+				break;
+			}
+			case JAL:
+			{
+				const InstructionJ jump(word);
+				code[source] = encode_j(jump.rd, jump.immediate + extra);
+				break;
+			}
+			default:
+				// JALR, whose small positive offset sits in the top bits
+				code[source] = word + (extra << 20);
+				break;
+			}
+		}
+	}
+
+	inst_data ProgramGenerator::pick_alu(const RegisterName rd)
+	{
+		const Encoding& encoding = alu_encodings[uniform(0, size(alu_encodings) - 1)];
+		if (encoding.opcode == RR)
+			return encode_r(encoding, rd, pick_source(), pick_source());
+		if (encoding.funct3 == SLL || encoding.funct3 == SRL)
+			return encode_i(RI, encoding.funct3, rd, pick_source(), encoding.funct7 << 5 | uniform(0, 31));
+		return encode_i(RI, encoding.funct3, rd, pick_source(), uniform(0, 0xFFF));
+	}
+
+	uint16_t ProgramGenerator::pick_compressed(const unsigned_data next_word)
+	{
+		// only a0 to a5 are free among the registers the three bit fields reach, s0 is the base of C.LW and C.SW
+		const auto compact_destination = static_cast<RegisterName>(uniform(a0, a5));
+		const auto compact_source = static_cast<RegisterName>(uniform(s0, a5));
+		const RegisterName rd = pick_destination();
+		RegisterName rs2 = pick_source();
+		if (rs2 == zero)
+			rs2 = ra;
+		const unsigned_data immediate = uniform(0, 0x3F);
+		const unsigned_data offset = uniform(0, 31) << 2;
+
+		switch (uniform(0, 9))
+		{
+		case 0:
+			// C.ADDI and C.LI
+			return static_cast<uint16_t>(uniform(0, 1) << 14 | (immediate >> 5) << 12 | rd << 7 | (immediate & 0x1F) << 2 | 0x1);
+		case 1:
+			// C.MV and C.ADD
+			return static_cast<uint16_t>(0x4 << 13 | uniform(0, 1) << 12 | rd << 7 | rs2 << 2 | 0x2);
+		case 2:
+			// C.SLLI
+			return static_cast<uint16_t>(rd << 7 | uniform(0, 31) << 2 | 0x2);
+		case 3:
+		{
+			// C.SRLI, C.SRAI and C.ANDI
+			const unsigned_data funct2 = uniform(0, 2);
+			const unsigned_data operand = funct2 == 2 ? immediate : uniform(0, 31);
+			return static_cast<uint16_t>(0x4 << 13 | (operand >> 5) << 12 | funct2 << 10 | (compact_destination - 8) << 7 | (operand & 0x1F) << 2 | 0x1);
+		}
+		case 4:
+			// C.SUB, C.XOR, C.OR and C.AND
+			return static_cast<uint16_t>(0x4 << 13 | 0x3 << 10 | (compact_destination - 8) << 7 | uniform(0, 3) << 5 | (compact_source - 8) << 2 | 0x1);
+		case 5:
+			// C.LW
+			return static_cast<uint16_t>(0x2 << 13 | (offset >> 3 & 0x7) << 10 | (offset >> 2 & 0x1) << 6 | (offset >> 6 & 0x1) << 5 |
+				(compact_destination - 8) << 2);
+		case 6:
+			// C.SW
+			return static_cast<uint16_t>(0x6 << 13 | (offset >> 3 & 0x7) << 10 | (offset >> 2 & 0x1) << 6 | (offset >> 6 & 0x1) << 5 |
+				(compact_source - 8) << 2);
+		case 7:
+			// C.BEQZ and C.BNEZ to the next word
+			return encode_cb(static_cast<uint16_t>(uniform(6, 7)), compact_source, next_word);
+		case 8:
+			// C.JAL links the address 2 past itself
+			return encode_cj(0x1, next_word);
+		default:
+			return encode_cj(0x5, next_word);
+		}
+	}
+
+	RegisterName ProgramGenerator::pick_source()
+	{
+		if (uniform(0, 1))
+			return recent[uniform(0, size(recent) - 1)];
+		return static_cast<RegisterName>(uniform(0, 31));
+	}
+
+	RegisterName ProgramGenerator::pick_destination()
+	{
+		RegisterName reg;
+		do
+			reg = static_cast<RegisterName>(uniform(0, 31));
+		while (reg == base_register || reg == scratch_register || reg == loop_register || reg == atomic_register);
+		return reg;
+	}
+
+	unsigned_data ProgramGenerator::pick_value()
+	{
+		if (uniform(0, 1))
+			return edge_values[uniform(0, size(edge_values) - 1)];
+		return static_cast<unsigned_data>(random());
+	}
+
+	uint32_t ProgramGenerator::uniform(const uint32_t low, const uint32_t high)
+	{
+		return uniform_int_distribution<uint32_t>(low, high)(random);
+	}
+}
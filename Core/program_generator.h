@@ -0,0 +1,54 @@
+#pragma once
+#include <memory>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "common.h"
+
+namespace RV32IM
+{
+	// Builds random but well-formed RV32IMAC programs for fuzzing. Control flow only jumps forward, apart from
+	// counted loops, so every program terminates in the spin loop at its end.
+	// Register roles: s0 points at the data area, s1 is the jump scratch register, t2 counts loop iterations
+	// and s2 holds the address of the next atomic.
+	class ProgramGenerator
+	{
+	public:
+		static constexpr size_t MEMORY_SIZE = 0x10000;
+		static constexpr unsigned_data DATA_BASE = 0xC000;
+
+		explicit ProgramGenerator(uint64_t seed);
+
+		// returns the code words, the last one being the terminating spin loop
+		vector<inst_data> generate(size_t length);
+		// places the code at address 0 and fills the data area with random bytes
+		shared_ptr<uint8_t[]> build_memory(const vector<inst_data>& code);
+
+		[[nodiscard]] static unsigned_data get_exit_address(const vector<inst_data>& code);
+
+	private:
+		void emit_prologue(vector<inst_data>& code);
+		void emit_random(vector<inst_data>& code, size_t remaining, bool in_loop);
+		void emit_loop(vector<inst_data>& code, size_t remaining);
+		void retarget_blocked_words(vector<inst_data>& code) const;
+
+		inst_data pick_alu(RegisterName rd);
+		// an RVC instruction, next_word is the distance of its branch or jump to the following word boundary
+		uint16_t pick_compressed(unsigned_data next_word);
+		RegisterName pick_source();
+		RegisterName pick_destination();
+		unsigned_data pick_value();
+		uint32_t uniform(uint32_t low, uint32_t high);
+
+		mt19937_64 random;
+		// recently written registers are preferred as sources to provoke forwarding and load-use stalls
+		RegisterName recent[4];
+		size_t recent_head;
+		// words no jump may land on: the second words of the RVC groups, which begin with the upper half of an
+		// instruction, and the JALR of each AUIPC/JALR pair, which would use a stale s1
+		vector<size_t> blocked_words;
+		// index of each forward branch or jump and the index of the word it lands on
+		vector<pair<size_t, size_t>> forward_jumps;
+	};
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include <memory>
+
+#include "common.h"
+#include "symbol_table.h"
+
+namespace RV32IM
+{
+	// guest memory contents produced by one of the program loaders
+	struct ProgramImage
+	{
+		shared_ptr<uint8_t[]> memory;
+		size_t memory_size;
+		unsigned_data entry_point;
+		SymbolTable symbols;
+	};
+}
@@ -24,6 +24,13 @@ namespace RV32IM
 				output = input;
 		}
 
+		void reset()
+		{
+			input = 0;
+			output = 0;
+			write_enable = true;
+		}
+
 	private:
 		T input;
 		T output;
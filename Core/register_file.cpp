@@ -2,23 +2,39 @@
 
 namespace RV32IM
 {
-	unsigned_data RegisterFile::read(const RegisterName reg) const
+	RegisterFile::RegisterFile() : registers(), pending_register(zero), pending_value(0), pending_valid(false) {}
+
+	void RegisterFile::write(const RegisterName reg, const unsigned_data value)
 	{
-		return reg == 0 ? 0 : outputs[reg];
+		pending_register = reg;
+		pending_value = value;
+		pending_valid = reg != zero;
 	}
 
-	auto RegisterFile::write(const RegisterName reg, const unsigned_data value) -> void
+	void RegisterFile::set(const RegisterName reg, const unsigned_data value)
 	{
-		inputs[reg] = value;
+		registers[reg] = value;
+		if (pending_valid && pending_register == reg)
+			pending_value = value;
 	}
 
 	void RegisterFile::clock()
 	{
-		ranges::copy(inputs, outputs.begin());
+		if (pending_valid)
+			registers[pending_register] = pending_value;
+		pending_valid = false;
+	}
+
+	void RegisterFile::reset()
+	{
+		registers.fill(0);
+		pending_register = zero;
+		pending_value = 0;
+		pending_valid = false;
 	}
 
 	array<unsigned_data, RegisterFile::NUM_REGISTERS>& RegisterFile::get_registers()
 	{
-		return outputs;
+		return registers;
 	}
 }
@@ -5,19 +5,31 @@
 
 namespace RV32IM
 {
+	// One write port: write-back latches a single register and the next clock commits just that one.
+	// Reads see the latched write already, like a register file written in the first half of the cycle,
+	// so decode needs no separate forwarding path from write-back.
 	class RegisterFile
 	{
 	public:
 		static constexpr size_t NUM_REGISTERS = 32;
-		RegisterFile() = default;
+		RegisterFile();
 
-		unsigned_data read(RegisterName reg) const;
+		unsigned_data read(RegisterName reg) const
+		{
+			return pending_valid && reg == pending_register ? pending_value : registers[reg];
+		}
+		// writes to x0 are dropped, so it always reads as 0 without a check
 		void write(RegisterName reg, unsigned_data value);
+		// writes through the latch, for debuggers changing state between clocks
+		void set(RegisterName reg, unsigned_data value);
 
 		void clock();
+		void reset();
 		array<unsigned_data, NUM_REGISTERS>& get_registers();
 	private:
-		array<unsigned_data, NUM_REGISTERS> inputs;
-		array<unsigned_data, NUM_REGISTERS> outputs;
+		array<unsigned_data, NUM_REGISTERS> registers;
+		RegisterName pending_register;
+		unsigned_data pending_value;
+		bool pending_valid;
 	};
 }
@@ -0,0 +1,147 @@
+#include "sampling.h"
+
+#include <cmath>
+#include <limits>
+
+#include "core.h"
+
+namespace RV32IM
+{
+	namespace
+	{
+		// two sided 95% quantile of the normal distribution, SMARTS takes enough samples for it to hold
+		constexpr double Z_95 = 1.96;
+	}
+
+	double SamplingResult::get_estimated_cycles() const
+	{
+		return cpi * static_cast<double>(instructions);
+	}
+
+	SampledSimulation::SampledSimulation(Core& core, const SamplingConfig& config) :
+		core(core),
+		config(config),
+		interpreter(core.memory, core.fetch->get_next_PC())
+	{
+		if (this->config.window == 0)
+			this->config.window = 1;
+	}
+
+	SamplingResult SampledSimulation::run(const uint64_t instructions)
+	{
+		core.stop_clock();
+		core.drain();
+		leave_pipeline();
+
+		SamplingResult result{};
+		const uint64_t detailed = config.detailed_warmup + config.window;
+		const uint64_t skip = config.period > config.functional_warmup + detailed ? config.period - config.functional_warmup - detailed : 0;
+		while (result.instructions < instructions)
+		{
+			// too little left for another sample, finish functionally
+			const uint64_t remaining = instructions - result.instructions;
+			if (remaining < skip + config.functional_warmup + detailed)
+			{
+				fast_forward(remaining, false);
+				result.instructions += remaining;
+				break;
+			}
+
+			fast_forward(skip, false);
+			fast_forward(config.functional_warmup, true);
+			uint64_t retired;
+			const uint64_t cycles = run_detailed(retired);
+			result.instructions += skip + config.functional_warmup + retired;
+			result.detailed_instructions += retired;
+			result.sample_cpi.push_back(static_cast<double>(cycles) / static_cast<double>(config.window));
+		}
+		enter_pipeline();
+
+		const size_t samples = result.sample_cpi.size();
+		for (const double cpi : result.sample_cpi)
+			result.cpi += cpi;
+		result.cpi = samples == 0 ? 0.0 : result.cpi / static_cast<double>(samples);
+		double variance = 0.0;
+		for (const double cpi : result.sample_cpi)
+			variance += (cpi - result.cpi) * (cpi - result.cpi);
+		result.confidence = samples < 2 ? numeric_limits<double>::infinity() :
+			Z_95 * sqrt(variance / static_cast<double>(samples - 1) / static_cast<double>(samples));
+		return result;
+	}
+
+	void SampledSimulation::fast_forward(const uint64_t instructions, const bool warm)
+	{
+		if (!warm)
+		{
+			interpreter.run(instructions);
+			return;
+		}
+
+		// train the same structures the pipeline would, the return address stack refills within a few calls
+		CacheHierarchy* caches = core.caches.get();
+		for (uint64_t i = 0; i < instructions; i++)
+		{
+			const TraceRecord record = interpreter.step();
+			const unsigned_data length = record.flags & TRACE_COMPRESSED ? 2 : 4;
+			const unsigned_data next_pc = interpreter.get_pc();
+			if (caches)
+			{
+				caches->fetch(record.pc, length);
+				if (record.flags & TRACE_STORE)
+					caches->store(record.memory_address);
+				else if (record.flags & TRACE_LOAD)
+					caches->load(record.memory_address);
+			}
+			switch (record.inst & 0x7F)
+			{
+			case Opcodes::BXX:
+				core.branch->update_table(record.pc, next_pc != record.pc + length);
+				break;
+			case Opcodes::JALR:
+				core.target_buffer->update(record.pc, next_pc);
+				break;
+			default:
+				break;
+			}
+		}
+		// the penalties of warming misses were never paid by the pipeline, so they are not stall cycles either
+		if (caches)
+			caches->discard_stall();
+	}
+
+	uint64_t SampledSimulation::run_detailed(uint64_t& instructions)
+	{
+		enter_pipeline();
+		const PerformanceCounters& counters = *core.counters;
+		const uint64_t start = counters.get_instructions_retired();
+		while (counters.get_instructions_retired() - start < config.detailed_warmup)
+			core.clock();
+
+		const uint64_t measure_start = counters.get_instructions_retired();
+		const uint64_t cycle_start = counters.get_cycles();
+		while (counters.get_instructions_retired() - measure_start < config.window)
+			core.clock();
+		const uint64_t cycles = counters.get_cycles() - cycle_start;
+
+		leave_pipeline();
+		instructions = counters.get_instructions_retired() - start;
+		return cycles;
+	}
+
+	void SampledSimulation::enter_pipeline()
+	{
+		const auto& registers = interpreter.get_registers();
+		for (size_t reg = 1; reg < RegisterFile::NUM_REGISTERS; reg++)
+			core.set_register(static_cast<RegisterName>(reg), registers[reg]);
+		core.set_pc(interpreter.get_pc());
+	}
+
+	void SampledSimulation::leave_pipeline()
+	{
+		core.drain();
+		const auto& registers = core.get_registers();
+		for (size_t reg = 1; reg < RegisterFile::NUM_REGISTERS; reg++)
+			interpreter.set_register(static_cast<RegisterName>(reg), registers[reg]);
+		interpreter.set_pc(core.fetch->get_next_PC());
+	}
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <vector>
+
+#include "common.h"
+#include "interpreter.h"
+
+namespace RV32IM
+{
+	class Core;
+
+	struct SamplingConfig
+	{
+		uint64_t period = 1000000;	// instructions from the start of one sample to the start of the next
+		uint64_t functional_warmup = 100000;	// instructions before each sample that only train the predictors and caches
+		uint64_t detailed_warmup = 2000;	// pipeline instructions that refill it before measuring
+		uint64_t window = 10000;	// pipeline instructions measured per sample
+	};
+
+	struct SamplingResult
+	{
+		uint64_t instructions;
+		uint64_t detailed_instructions;
+		vector<double> sample_cpi;
+		double cpi;
+		// half width of the 95% confidence interval around cpi, infinite with fewer than two samples
+		double confidence;
+
+		[[nodiscard]] double get_estimated_cycles() const;
+	};
+
+	// SMARTS style sampled simulation. The functional model fast-forwards between samples, trains the branch predictor,
+	// BTB and caches in the stretch just before each one, then hands its registers and PC to the pipeline, which measures
+	// the CPI of a short window and hands the state back. Memory is shared, so nothing else needs copying.
+	// The functional model reads every CSR as 0 and takes no interrupts, so sample programs that do not rely on either.
+	// Load or reset the core before constructing, its clock must not be running.
+	class SampledSimulation
+	{
+	public:
+		SampledSimulation(Core& core, const SamplingConfig& config = {});
+
+		// runs at least the given number of instructions and leaves the final architectural state in the core
+		SamplingResult run(uint64_t instructions);
+
+	private:
+		void fast_forward(uint64_t instructions, bool warm);
+		// returns the cycles spent measuring window instructions after the detailed warm-up
+		uint64_t run_detailed(uint64_t& instructions);
+		void enter_pipeline();
+		void leave_pipeline();
+
+		Core& core;
+		SamplingConfig config;
+		Interpreter interpreter;
+	};
+}
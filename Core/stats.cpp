@@ -0,0 +1,204 @@
+#include "stats.h"
+
+#include <cstdio>
+#include <fstream>
+
+#include "performance_counters.h"
+
+namespace RV32IM
+{
+	namespace
+	{
+		// the instance label is user supplied, so quotes, backslashes and line breaks must not end the value early
+		string escape_label(const string& value)
+		{
+			string escaped;
+			for (const char character : value)
+			{
+				if (character == '\\' || character == '"')
+					escaped += '\\';
+				if (character == '\n')
+					escaped += "\\n";
+				else
+					escaped += character;
+			}
+			return escaped;
+		}
+
+		string escape_json(const string& value)
+		{
+			static constexpr char HEX_DIGITS[] = "0123456789abcdef";
+			string escaped;
+			for (const char character : value)
+			{
+				const auto byte = static_cast<unsigned char>(character);
+				if (character == '\\' || character == '"')
+				{
+					escaped += '\\';
+					escaped += character;
+				}
+				else if (byte < 0x20)
+				{
+					escaped += "\\u00";
+					escaped += HEX_DIGITS[byte >> 4];
+					escaped += HEX_DIGITS[byte & 0xF];
+				}
+				else
+					escaped += character;
+			}
+			return escaped;
+		}
+	}
+
+	StatsSnapshot StatsSnapshot::since(const StatsSnapshot& earlier) const
+	{
+		StatsSnapshot difference = *this;
+		difference.cycles -= earlier.cycles;
+		difference.instructions_retired -= earlier.instructions_retired;
+		difference.stalls -= earlier.stalls;
+		difference.flushes -= earlier.flushes;
+		difference.irqs -= earlier.irqs;
+		difference.uart_bytes -= earlier.uart_bytes;
+		difference.frames -= earlier.frames;
+		return difference;
+	}
+
+	double StatsSnapshot::get_seconds_since(const StatsSnapshot& earlier) const
+	{
+		return chrono::duration<double>(time - earlier.time).count();
+	}
+
+	Statistics::Statistics() : cycles(0), instructions_retired(0), stalls(0), flushes(0), irqs(0), uart_bytes(0), frames(0),
+		clock_time(0), processing_time(0)
+	{
+	}
+
+	void Statistics::publish(const PerformanceCounters& counters)
+	{
+		cycles.store(counters.get_cycles(), memory_order_relaxed);
+		instructions_retired.store(counters.get_instructions_retired(), memory_order_relaxed);
+		stalls.store(counters.get_stalls(), memory_order_relaxed);
+		flushes.store(counters.get_mispredicts(), memory_order_relaxed);
+	}
+
+	void Statistics::publish_timing(const int clock_time, const int processing_time)
+	{
+		this->clock_time.store(clock_time, memory_order_relaxed);
+		this->processing_time.store(processing_time, memory_order_relaxed);
+	}
+
+	void Statistics::reset()
+	{
+		for (atomic<uint64_t>* counter : { &cycles, &instructions_retired, &stalls, &flushes, &irqs, &uart_bytes, &frames })
+			counter->store(0, memory_order_relaxed);
+		publish_timing(0, 0);
+	}
+
+	StatsSnapshot Statistics::snapshot() const
+	{
+		return {
+			chrono::steady_clock::now(),
+			cycles.load(memory_order_relaxed),
+			instructions_retired.load(memory_order_relaxed),
+			stalls.load(memory_order_relaxed),
+			flushes.load(memory_order_relaxed),
+			irqs.load(memory_order_relaxed),
+			uart_bytes.load(memory_order_relaxed),
+			frames.load(memory_order_relaxed),
+			clock_time.load(memory_order_relaxed),
+			processing_time.load(memory_order_relaxed)
+		};
+	}
+
+	int Statistics::get_clock_time() const
+	{
+		return clock_time.load(memory_order_relaxed);
+	}
+
+	int Statistics::get_processing_time() const
+	{
+		return processing_time.load(memory_order_relaxed);
+	}
+
+	StatsExporter::StatsExporter(const Statistics& statistics, const string& file_path, const StatsFormat format,
+		const chrono::milliseconds period, const string& instance) :
+		statistics(statistics), file_path(file_path), format(format), period(period), instance(instance), stop_exporting(false)
+	{
+		// JSON lines only ever append, so start from an empty file
+		if (!ofstream(file_path, ios::trunc))
+			throw StatsError("Unable to open statistics file!");
+		export_thread = thread(&StatsExporter::export_loop, this);
+	}
+
+	StatsExporter::~StatsExporter()
+	{
+		{
+			lock_guard lock(stop_mutex);
+			stop_exporting = true;
+		}
+		stop_changed.notify_all();
+		if (export_thread.joinable())
+			export_thread.join();
+		write();
+	}
+
+	void StatsExporter::write() const
+	{
+		const StatsSnapshot snapshot = statistics.snapshot();
+		if (format == StatsFormat::PROMETHEUS)
+			write_prometheus(snapshot);
+		else
+			write_json(snapshot);
+	}
+
+	void StatsExporter::write_prometheus(const StatsSnapshot& snapshot) const
+	{
+		const string labels = instance.empty() ? "" : "{instance=\"" + escape_label(instance) + "\"}";
+		const string temporary_path = file_path + ".tmp";
+		{
+			ofstream file(temporary_path, ios::trunc);
+			const auto metric = [&](const char* name, const char* type, const auto value)
+			{
+				file << "# TYPE rv32_" << name << ' ' << type << '\n' << "rv32_" << name << labels << ' ' << value << '\n';
+			};
+			metric("cycles_total", "counter", snapshot.cycles);
+			metric("instructions_retired_total", "counter", snapshot.instructions_retired);
+			metric("stalls_total", "counter", snapshot.stalls);
+			metric("flushes_total", "counter", snapshot.flushes);
+			metric("irqs_total", "counter", snapshot.irqs);
+			metric("uart_bytes_total", "counter", snapshot.uart_bytes);
+			metric("frames_total", "counter", snapshot.frames);
+			metric("clock_time_nanoseconds", "gauge", snapshot.clock_time);
+			metric("processing_time_nanoseconds", "gauge", snapshot.processing_time);
+		}
+		// rename does not replace an existing file on Windows, elsewhere it does so atomically
+#ifdef _WIN32
+		remove(file_path.c_str());
+#endif
+		rename(temporary_path.c_str(), file_path.c_str());
+	}
+
+	void StatsExporter::write_json(const StatsSnapshot& snapshot) const
+	{
+		const auto timestamp = chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now().time_since_epoch()).count();
+		ofstream file(file_path, ios::app);
+		file << "{\"timestamp_ms\":" << timestamp;
+		if (!instance.empty())
+			file << ",\"instance\":\"" << escape_json(instance) << '"';
+		file << ",\"cycles\":" << snapshot.cycles << ",\"instructions_retired\":" << snapshot.instructions_retired <<
+			",\"stalls\":" << snapshot.stalls << ",\"flushes\":" << snapshot.flushes << ",\"irqs\":" << snapshot.irqs <<
+			",\"uart_bytes\":" << snapshot.uart_bytes << ",\"frames\":" << snapshot.frames <<
+			",\"clock_time_ns\":" << snapshot.clock_time << ",\"processing_time_ns\":" << snapshot.processing_time << "}\n";
+	}
+
+	void StatsExporter::export_loop()
+	{
+		unique_lock lock(stop_mutex);
+		while (!stop_changed.wait_for(lock, period, [this] { return stop_exporting; }))
+		{
+			lock.unlock();
+			write();
+			lock.lock();
+		}
+	}
+}
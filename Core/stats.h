@@ -0,0 +1,113 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "common.h"
+
+namespace RV32IM
+{
+	class PerformanceCounters;
+
+	// plain copy of the statistics at one moment, cheap to keep around and subtract
+	struct StatsSnapshot
+	{
+		chrono::steady_clock::time_point time;
+		uint64_t cycles;
+		uint64_t instructions_retired;
+		uint64_t stalls;
+		uint64_t flushes;
+		uint64_t irqs;
+		uint64_t uart_bytes;
+		uint64_t frames;
+		// moving averages in ns, not counters, so since() keeps the newer values
+		int clock_time;
+		int processing_time;
+
+		// counts accumulated after earlier was taken
+		[[nodiscard]] StatsSnapshot since(const StatsSnapshot& earlier) const;
+		[[nodiscard]] double get_seconds_since(const StatsSnapshot& earlier) const;
+	};
+
+	// Counters any thread may read while the core runs. The pipeline keeps counting into PerformanceCounters and the
+	// clock thread publishes them once per batch of cycles, so the hot loop never touches an atomic. The rare events
+	// come from several threads and are added directly. Everything is relaxed, a snapshot may mix values a batch apart.
+	class Statistics
+	{
+	public:
+		Statistics();
+
+		void publish(const PerformanceCounters& counters);
+		void publish_timing(int clock_time, int processing_time);
+		void count_irq() { irqs.fetch_add(1, memory_order_relaxed); }
+		void count_uart_byte() { uart_bytes.fetch_add(1, memory_order_relaxed); }
+		void count_frame() { frames.fetch_add(1, memory_order_relaxed); }
+		void reset();
+
+		[[nodiscard]] StatsSnapshot snapshot() const;
+		[[nodiscard]] int get_clock_time() const;
+		[[nodiscard]] int get_processing_time() const;
+
+	private:
+		atomic<uint64_t> cycles;
+		atomic<uint64_t> instructions_retired;
+		atomic<uint64_t> stalls;
+		atomic<uint64_t> flushes;
+		atomic<uint64_t> irqs;
+		atomic<uint64_t> uart_bytes;
+		atomic<uint64_t> frames;
+		atomic<int> clock_time;
+		atomic<int> processing_time;
+	};
+
+	enum class StatsFormat { PROMETHEUS, JSON_LINES };
+
+	class StatsError : public exception
+	{
+	public:
+		explicit StatsError(string message) : message(std::move(message)) {}
+
+		const char* what() const noexcept override
+		{
+			return message.c_str();
+		}
+
+	private:
+		string message;
+	};
+
+	// Writes the statistics every period from its own thread. Prometheus output replaces the file each time, through a
+	// rename so a textfile collector never reads half of it, JSON lines are appended.
+	class StatsExporter
+	{
+	public:
+		StatsExporter(const Statistics& statistics, const string& file_path, StatsFormat format,
+			chrono::milliseconds period = chrono::milliseconds(1000), const string& instance = "");
+		// writes once more before returning
+		~StatsExporter();
+
+		StatsExporter(const StatsExporter&) = delete;
+		StatsExporter& operator=(const StatsExporter&) = delete;
+
+		void write() const;
+
+	private:
+		void write_prometheus(const StatsSnapshot& snapshot) const;
+		void write_json(const StatsSnapshot& snapshot) const;
+		void export_loop();
+
+		const Statistics& statistics;
+		string file_path;
+		StatsFormat format;
+		chrono::milliseconds period;
+		string instance;
+
+		mutex stop_mutex;
+		condition_variable stop_changed;
+		bool stop_exporting;
+		thread export_thread;
+	};
+}
@@ -0,0 +1,63 @@
+#include "symbol_table.h"
+
+#include <algorithm>
+
+namespace RV32IM
+{
+	void SymbolTable::add_symbol(const string& name, const unsigned_data address, const unsigned_data size)
+	{
+		symbols.push_back(Symbol{ name, address, size });
+	}
+
+	void SymbolTable::sort()
+	{
+		ranges::sort(symbols, [](const Symbol& a, const Symbol& b) { return a.address < b.address; });
+	}
+
+	void SymbolTable::clear()
+	{
+		symbols.clear();
+	}
+
+	const Symbol* SymbolTable::lookup(const unsigned_data address) const
+	{
+		// last symbol starting at or before the address
+		const auto next = ranges::upper_bound(symbols, address, {}, &Symbol::address);
+		if (next == symbols.begin())
+			return nullptr;
+
+		const Symbol& symbol = *(next - 1);
+		// symbols without a size (assembly labels) cover everything up to the next symbol
+		if (symbol.size != 0 && address >= symbol.address + symbol.size)
+			return nullptr;
+		return &symbol;
+	}
+
+	optional<unsigned_data> SymbolTable::find(const string& name) const
+	{
+		const auto symbol = ranges::find(symbols, name, &Symbol::name);
+		if (symbol == symbols.end())
+			return nullopt;
+		return symbol->address;
+	}
+
+	string SymbolTable::describe(const unsigned_data address) const
+	{
+		const Symbol* symbol = lookup(address);
+		if (symbol == nullptr)
+			return to_hex(address);
+		if (symbol->address == address)
+			return symbol->name;
+		return symbol->name + "+" + to_string(address - symbol->address);
+	}
+
+	bool SymbolTable::empty() const
+	{
+		return symbols.empty();
+	}
+
+	const vector<Symbol>& SymbolTable::get_symbols() const
+	{
+		return symbols;
+	}
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "common.h"
+
+namespace RV32IM
+{
+	struct Symbol
+	{
+		string name;
+		unsigned_data address;
+		unsigned_data size;
+	};
+
+	// guest symbols sorted by address for PC -> name lookups
+	class SymbolTable
+	{
+	public:
+		void add_symbol(const string& name, unsigned_data address, unsigned_data size);
+		void sort();
+		void clear();
+
+		[[nodiscard]] const Symbol* lookup(unsigned_data address) const;
+		[[nodiscard]] optional<unsigned_data> find(const string& name) const;
+		[[nodiscard]] string describe(unsigned_data address) const;
+		[[nodiscard]] bool empty() const;
+		[[nodiscard]] const vector<Symbol>& get_symbols() const;
+
+	private:
+		vector<Symbol> symbols;
+	};
+}
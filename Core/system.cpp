@@ -0,0 +1,119 @@
+#include "system.h"
+
+#include <algorithm>
+
+namespace RV32IM
+{
+	System::System(const size_t num_harts, const int time_per_clock, const int video_width, const int video_height,
+		const PredictorConfig& predictor_config) :
+		memory(new UnifiedMemory(0x100)),
+		memory_size(0x100),
+		page_backing(PageBacking::NORMAL)
+	{
+		for (size_t hart_id = 0; hart_id < max<size_t>(num_harts, 1); hart_id++)
+			harts.push_back(make_unique<Core>(time_per_clock, video_width, video_height, predictor_config, static_cast<unsigned_data>(hart_id)));
+	}
+
+	void System::load_memory_contents(const shared_ptr<uint8_t[]>& new_memory, const size_t new_memory_size, const unsigned_data entry_point)
+	{
+		stop();
+		memory_size = new_memory_size;
+		memory = make_shared<UnifiedMemory>(new_memory, memory_size, page_backing);
+		for (const auto& hart : harts)
+			hart->attach_memory(memory, memory_size, entry_point);
+	}
+
+	void System::set_page_backing(const PageBacking backing)
+	{
+		page_backing = backing;
+		for (const auto& hart : harts)
+			hart->set_page_backing(backing);
+	}
+
+	void System::load_program_image(ProgramImage image)
+	{
+		load_memory_contents(image.memory, image.memory_size, image.entry_point);
+		harts.front()->symbols = std::move(image.symbols);
+	}
+
+	void System::load_elf(const string& file_path)
+	{
+		load_program_image(ElfLoader::load(file_path));
+	}
+
+	void System::start()
+	{
+		for (const auto& hart : harts)
+			hart->start_clock();
+	}
+
+	void System::stop()
+	{
+		for (const auto& hart : harts)
+			hart->stop_clock();
+	}
+
+	bool System::run_round_robin(const uint64_t cycles, const uint64_t quantum)
+	{
+		if (is_running())
+			return true;
+
+		Core& device_hart = *harts.front();
+		device_hart.video_interface->stop_drawing();
+		for (uint64_t done = 0; done < cycles;)
+		{
+			const uint64_t slice = min(max<uint64_t>(quantum, 1), cycles - done);
+			for (const auto& hart : harts)
+			{
+				for (uint64_t i = 0; i < slice; i++)
+				{
+					if (!hart->debug_points)
+						hart->clock();
+					else if (hart->clock_checked())
+					{
+						device_hart.video_interface->draw_frame();
+						return false;
+					}
+				}
+			}
+			done += slice;
+			for (const auto& hart : harts)
+				hart->statistics.publish(*hart->counters);
+			// devices are serviced at quantum boundaries only, the wall-clock timer stays off so runs repeat exactly
+			device_hart.poll_uart();
+		}
+		device_hart.video_interface->draw_frame();
+		return true;
+	}
+
+	void System::reset()
+	{
+		for (const auto& hart : harts)
+			hart->reset();
+	}
+
+	bool System::is_running() const
+	{
+		return ranges::any_of(harts, [](const unique_ptr<Core>& hart) { return hart->is_clock_running(); });
+	}
+
+	size_t System::get_num_harts() const
+	{
+		return harts.size();
+	}
+
+	Core& System::get_hart(const size_t hart_id) const
+	{
+		return *harts.at(hart_id);
+	}
+
+	shared_ptr<uint8_t[]>& System::get_memory_ptr() const
+	{
+		return memory->get_memory_ptr();
+	}
+
+	size_t System::get_memory_size() const
+	{
+		return memory_size;
+	}
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "common.h"
+#include "core.h"
+#include "program_image.h"
+
+namespace RV32IM
+{
+	// N harts sharing one UnifiedMemory. Each hart is a full Core with its own pipeline, register file, predictor
+	// and counters and reads its index from mhartid, every hart starts at the entry point. Hart 0 owns the timer,
+	// UART, video and interrupts. start runs every hart on its own host thread, run_round_robin interleaves them
+	// on the calling thread in fixed quanta so a run can be reproduced exactly.
+	class System
+	{
+	public:
+		static constexpr uint64_t DEFAULT_QUANTUM = 64;
+
+		explicit System(size_t num_harts, int time_per_clock = 0, int video_width = 320, int video_height = 240,
+			const PredictorConfig& predictor_config = {});
+
+		System(const System&) = delete;
+		System& operator=(const System&) = delete;
+
+		void load_memory_contents(const shared_ptr<uint8_t[]>& new_memory, size_t new_memory_size, unsigned_data entry_point = 0);
+		// see Core::set_page_backing, applies to the shared memory and every hart's predictor tables
+		void set_page_backing(PageBacking backing);
+		void load_program_image(ProgramImage image);
+		void load_elf(const string& file_path);
+
+		void start();
+		// returns once every hart is paused
+		void stop();
+		// while stopped: clocks each hart for quantum cycles in hart order until every hart ran the given number of cycles,
+		// returns false early if a hart stopped at a breakpoint or watchpoint
+		bool run_round_robin(uint64_t cycles, uint64_t quantum = DEFAULT_QUANTUM);
+		void reset();
+
+		[[nodiscard]] bool is_running() const;
+		[[nodiscard]] size_t get_num_harts() const;
+		[[nodiscard]] Core& get_hart(size_t hart_id) const;
+		[[nodiscard]] shared_ptr<uint8_t[]>& get_memory_ptr() const;
+		[[nodiscard]] size_t get_memory_size() const;
+
+	private:
+		vector<unique_ptr<Core>> harts;
+		shared_ptr<UnifiedMemory> memory;
+		size_t memory_size;
+		PageBacking page_backing;
+	};
+}
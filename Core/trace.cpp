@@ -0,0 +1,256 @@
+#include "trace.h"
+
+#include <cstring>
+
+namespace RV32IM
+{
+	namespace
+	{
+		constexpr uint32_t TRACE_FILE_MAGIC = 0x52545652;   // "RVTR"
+		constexpr uint32_t TRACE_CHUNK_MAGIC = 0x43545652;  // "RVTC"
+		// version 2 added TRACE_COMPRESSED, which only changes where a sequential record's PC is
+		constexpr uint32_t TRACE_VERSION = 2;
+		constexpr size_t CHUNK_HEADER_SIZE = 12;
+		constexpr size_t MIN_RECORD_SIZE = 1 + 4;
+		constexpr size_t MAX_RECORD_SIZE = 1 + 5 + 4 + 5 + 5 + 5;
+		// the core blocks once this many chunks are waiting on the disk
+		constexpr size_t MAX_PENDING_CHUNKS = 8;
+
+		uint32_t zigzag_encode(const unsigned_data delta)
+		{
+			return (delta << 1) ^ static_cast<uint32_t>(static_cast<signed_data>(delta) >> 31);
+		}
+
+		unsigned_data zigzag_decode(const uint32_t value)
+		{
+			return (value >> 1) ^ (0 - (value & 1));
+		}
+
+		void put_word(vector<uint8_t>& buffer, const size_t offset, const uint32_t value)
+		{
+			memcpy(buffer.data() + offset, &value, sizeof(value));
+		}
+	}
+
+	TraceWriter::TraceWriter(const string& file_path, const size_t chunk_size) :
+		chunk_size(chunk_size), chunk_records(0), sequential_pc(4), last_address(0), stop_writing(false), write_failed(false)
+	{
+		// chunks are already large, so skip the stream's own buffering
+		file.rdbuf()->pubsetbuf(nullptr, 0);
+		file.open(file_path, ios::binary | ios::trunc);
+		if (!file)
+			throw TraceError("Unable to open trace file!");
+
+		const uint32_t header[2] = { TRACE_FILE_MAGIC, TRACE_VERSION };
+		if (!file.write(reinterpret_cast<const char*>(header), sizeof(header)))
+			throw TraceError("Unable to write trace file!");
+
+		chunk.reserve(chunk_size + MAX_RECORD_SIZE);
+		chunk.resize(CHUNK_HEADER_SIZE);
+		writer_thread = thread(&TraceWriter::write_loop, this);
+	}
+
+	TraceWriter::~TraceWriter()
+	{
+		seal_chunk();
+		{
+			lock_guard lock(chunk_mutex);
+			stop_writing = true;
+		}
+		chunk_ready.notify_one();
+		if (writer_thread.joinable())
+			writer_thread.join();
+	}
+
+	void TraceWriter::record(const TraceRecord& record)
+	{
+		uint8_t flags = record.flags;
+		if (record.pc == sequential_pc)
+			flags |= TRACE_SEQUENTIAL;
+
+		chunk.push_back(flags);
+		if (!(flags & TRACE_SEQUENTIAL))
+			put_varint(zigzag_encode(record.pc - sequential_pc));
+		const size_t inst_offset = chunk.size();
+		chunk.resize(inst_offset + sizeof(inst_data));
+		put_word(chunk, inst_offset, record.inst);
+
+		if (flags & TRACE_RD)
+			put_varint(record.rd_value);
+		if (flags & (TRACE_LOAD | TRACE_STORE))
+		{
+			put_varint(zigzag_encode(record.memory_address - last_address));
+			put_varint(record.memory_data);
+			last_address = record.memory_address;
+		}
+		sequential_pc = record.pc + (flags & TRACE_COMPRESSED ? 2 : 4);
+		chunk_records++;
+
+		if (chunk.size() >= chunk_size)
+			seal_chunk();
+	}
+
+	void TraceWriter::flush()
+	{
+		seal_chunk();
+		unique_lock lock(chunk_mutex);
+		chunk_written.wait(lock, [this] { return pending_chunks.empty(); });
+		if (write_failed || !file.flush())
+			throw TraceError("Unable to write trace file!");
+	}
+
+	void TraceWriter::seal_chunk()
+	{
+		if (chunk_records == 0)
+			return;
+
+		put_word(chunk, 0, TRACE_CHUNK_MAGIC);
+		put_word(chunk, 4, chunk_records);
+		put_word(chunk, 8, static_cast<uint32_t>(chunk.size() - CHUNK_HEADER_SIZE));
+
+		vector<uint8_t> next_chunk;
+		{
+			unique_lock lock(chunk_mutex);
+			chunk_written.wait(lock, [this] { return pending_chunks.size() < MAX_PENDING_CHUNKS; });
+			pending_chunks.push_back(std::move(chunk));
+			if (!free_chunks.empty())
+			{
+				next_chunk = std::move(free_chunks.back());
+				free_chunks.pop_back();
+			}
+		}
+		chunk_ready.notify_one();
+
+		chunk = std::move(next_chunk);
+		chunk.reserve(chunk_size + MAX_RECORD_SIZE);
+		chunk.resize(CHUNK_HEADER_SIZE);
+		chunk_records = 0;
+		sequential_pc = 4;
+		last_address = 0;
+	}
+
+	void TraceWriter::write_loop()
+	{
+		unique_lock lock(chunk_mutex);
+		while (true)
+		{
+			chunk_ready.wait(lock, [this] { return stop_writing || !pending_chunks.empty(); });
+			if (pending_chunks.empty())
+				break;
+
+			vector<uint8_t> sealed = std::move(pending_chunks.front());
+			const bool skip = write_failed;
+			lock.unlock();
+			const bool written = skip || file.write(reinterpret_cast<const char*>(sealed.data()), static_cast<streamsize>(sealed.size()));
+			sealed.clear();
+			lock.lock();
+			if (!written)
+				write_failed = true;
+
+			pending_chunks.pop_front();
+			free_chunks.push_back(std::move(sealed));
+			chunk_written.notify_all();
+		}
+		file.flush();
+	}
+
+	void TraceWriter::put_varint(uint32_t value)
+	{
+		while (value >= 0x80)
+		{
+			chunk.push_back(static_cast<uint8_t>(value | 0x80));
+			value >>= 7;
+		}
+		chunk.push_back(static_cast<uint8_t>(value));
+	}
+
+	TraceReader::TraceReader(const string& file_path) :
+		file(file_path, ios::binary), position(0), chunk_records(0), sequential_pc(4), last_address(0)
+	{
+		uint32_t header[2] = {};
+		file.read(reinterpret_cast<char*>(header), sizeof(header));
+		if (!file || header[0] != TRACE_FILE_MAGIC)
+			throw TraceError("Not a trace file!");
+		if (header[1] == 0 || header[1] > TRACE_VERSION)
+			throw TraceError("Unsupported trace version!");
+	}
+
+	bool TraceReader::next(TraceRecord& record)
+	{
+		if (chunk_records == 0 && !read_chunk())
+			return false;
+
+		if (position >= chunk.size())
+			throw TraceError("Corrupt trace chunk!");
+		record.flags = chunk[position++];
+		record.pc = sequential_pc;
+		if (!(record.flags & TRACE_SEQUENTIAL))
+			record.pc += zigzag_decode(get_varint());
+
+		if (position + sizeof(inst_data) > chunk.size())
+			throw TraceError("Corrupt trace chunk!");
+		memcpy(&record.inst, chunk.data() + position, sizeof(inst_data));
+		position += sizeof(inst_data);
+
+		record.rd_value = record.flags & TRACE_RD ? get_varint() : 0;
+		record.memory_address = 0;
+		record.memory_data = 0;
+		if (record.flags & (TRACE_LOAD | TRACE_STORE))
+		{
+			record.memory_address = last_address + zigzag_decode(get_varint());
+			record.memory_data = get_varint();
+			last_address = record.memory_address;
+		}
+
+		record.flags &= ~TRACE_SEQUENTIAL;
+		sequential_pc = record.pc + (record.flags & TRACE_COMPRESSED ? 2 : 4);
+		chunk_records--;
+		return true;
+	}
+
+	bool TraceReader::read_chunk()
+	{
+		uint32_t header[3] = {};
+		file.read(reinterpret_cast<char*>(header), sizeof(header));
+		if (!file)
+			return false;
+		if (header[0] != TRACE_CHUNK_MAGIC)
+			throw TraceError("Corrupt trace chunk!");
+
+		// the sizes come from the file, so check them against what is left of it before allocating
+		const streamoff chunk_start = file.tellg();
+		file.seekg(0, ios::end);
+		const streamoff remaining = file.tellg() - chunk_start;
+		file.seekg(chunk_start);
+		if (static_cast<streamoff>(header[2]) > remaining)
+			throw TraceError("Truncated trace chunk!");
+		if (static_cast<uint64_t>(header[1]) * MIN_RECORD_SIZE > header[2])
+			throw TraceError("Corrupt trace chunk!");
+
+		chunk.resize(header[2]);
+		file.read(reinterpret_cast<char*>(chunk.data()), header[2]);
+		if (!file)
+			throw TraceError("Truncated trace chunk!");
+
+		position = 0;
+		chunk_records = header[1];
+		sequential_pc = 4;
+		last_address = 0;
+		return chunk_records > 0 || read_chunk();
+	}
+
+	uint32_t TraceReader::get_varint()
+	{
+		uint32_t value = 0;
+		for (size_t shift{ 0 }; shift < 35; shift += 7)
+		{
+			if (position >= chunk.size())
+				throw TraceError("Corrupt trace chunk!");
+			const uint8_t byte = chunk[position++];
+			value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+			if (!(byte & 0x80))
+				return value;
+		}
+		throw TraceError("Corrupt trace chunk!");
+	}
+}
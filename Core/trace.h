@@ -0,0 +1,124 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common.h"
+
+namespace RV32IM
+{
+	enum TraceFlags : uint8_t
+	{
+		TRACE_RD = 0x01,
+		TRACE_LOAD = 0x02,
+		TRACE_STORE = 0x04,
+		TRACE_SEQUENTIAL = 0x08,
+		TRACE_COMPRESSED = 0x10	// inst holds the 32 bit expansion of an RVC instruction
+	};
+
+	// LR reads, SC writes and every other AMO does both
+	inline uint8_t atomic_trace_flags(const inst_data inst)
+	{
+		switch (inst >> 27)
+		{
+		case LR_W:
+			return TRACE_LOAD;
+		case SC_W:
+			return TRACE_STORE;
+		default:
+			return TRACE_LOAD | TRACE_STORE;
+		}
+	}
+
+	struct TraceRecord
+	{
+		unsigned_data pc;
+		inst_data inst;
+		unsigned_data rd_value;
+		unsigned_data memory_address;
+		unsigned_data memory_data;
+		uint8_t flags;
+	};
+
+	// Trace file layout:
+	//   file header: magic "RVTR", version
+	//   chunks: magic "RVTC", record count, payload size, payload
+	// Each record is a flags byte, a zigzag varint PC delta (omitted when the PC follows the last instruction),
+	// the raw instruction, then varints for the rd value and the memory address delta/data when flagged.
+	// Deltas restart at every chunk so chunks decode independently.
+	class TraceWriter
+	{
+	public:
+		static constexpr size_t DEFAULT_CHUNK_SIZE = 1 << 20;
+
+		TraceWriter(const string& file_path, size_t chunk_size = DEFAULT_CHUNK_SIZE);
+		~TraceWriter();
+
+		void record(const TraceRecord& record);
+		// throws TraceError if any chunk failed to reach the file
+		void flush();
+
+	private:
+		void seal_chunk();
+		void write_loop();
+
+		void put_varint(uint32_t value);
+
+		ofstream file;
+		size_t chunk_size;
+
+		vector<uint8_t> chunk;
+		uint32_t chunk_records;
+		unsigned_data sequential_pc;
+		unsigned_data last_address;
+
+		// sealed chunks are written by a background thread, buffers are recycled to avoid allocating
+		deque<vector<uint8_t>> pending_chunks;
+		vector<vector<uint8_t>> free_chunks;
+		mutex chunk_mutex;
+		condition_variable chunk_ready;
+		condition_variable chunk_written;
+		bool stop_writing;
+		// set by the writer thread, chunks after a failed write are dropped so the core never blocks on a dead file
+		bool write_failed;
+		thread writer_thread;
+	};
+
+	class TraceReader
+	{
+	public:
+		explicit TraceReader(const string& file_path);
+
+		bool next(TraceRecord& record);
+
+	private:
+		bool read_chunk();
+		uint32_t get_varint();
+
+		ifstream file;
+		vector<uint8_t> chunk;
+		size_t position;
+		uint32_t chunk_records;
+		unsigned_data sequential_pc;
+		unsigned_data last_address;
+	};
+
+	class TraceError : public exception
+	{
+	public:
+		explicit TraceError(string message) : message(std::move(message)) {}
+
+		const char* what() const noexcept override
+		{
+			return message.c_str();
+		}
+
+	private:
+		string message;
+	};
+}
@@ -1,6 +1,9 @@
 #pragma once
+#include <atomic>
+#include <cstring>
 #include <memory>
 
+#include "host_memory.h"
 
 namespace RV32IM
 {
@@ -9,9 +12,13 @@ namespace RV32IM
 	{
 	public:
 		UnifiedMemory();
-		UnifiedMemory(const size_t& memory_size);
+		UnifiedMemory(const size_t& memory_size, PageBacking backing = PageBacking::NORMAL);
+		// NORMAL shares the contents like load_memory_contents, huge page backings copy them into a buffer of their own
+		UnifiedMemory(const shared_ptr<uint8_t[]>& contents, size_t memory_size, PageBacking backing);
 		void load_memory_contents(const shared_ptr<uint8_t[]>& new_memory);
 		shared_ptr<uint8_t[]>& get_memory_ptr();
+		// what the host granted, NORMAL after load_memory_contents
+		[[nodiscard]] PageBacking get_page_backing() const;
 
 		uint32_t read_word(uint32_t address) const;
 		uint16_t read_half_word(uint32_t address) const;
@@ -21,6 +28,9 @@ namespace RV32IM
 		void write_half_word(uint32_t address, uint16_t data) const;
 		void write_byte(uint32_t address, uint8_t data) const;
 
+		// the aligned word holding the address, for A extension accesses shared between harts
+		atomic_ref<uint32_t> atomic_word(uint32_t address) const;
+
 		uint8_t& operator[](const uint8_t& address) const
 		{
 			return memory[address];
@@ -29,18 +39,33 @@ namespace RV32IM
 	private:
 		shared_ptr<uint8_t[]> memory;
 		size_t memory_size;
+		PageBacking page_backing;
 	};
 
 	inline UnifiedMemory::UnifiedMemory() : UnifiedMemory(0x100000)	{}
 
-	inline UnifiedMemory::UnifiedMemory(const size_t& memory_size) : memory(new uint8_t[memory_size]), memory_size(memory_size)
+	inline UnifiedMemory::UnifiedMemory(const size_t& memory_size, const PageBacking backing) : memory_size(memory_size)
 	{
-		memset(memory.get(), 0, sizeof(uint8_t) * memory_size);
+		HostBuffer buffer = allocate_host_memory(memory_size, backing);
+		memory = std::move(buffer.data);
+		page_backing = buffer.backing;
+	}
+
+	inline UnifiedMemory::UnifiedMemory(const shared_ptr<uint8_t[]>& contents, const size_t memory_size, const PageBacking backing) :
+		memory(contents), memory_size(memory_size), page_backing(PageBacking::NORMAL)
+	{
+		if (backing == PageBacking::NORMAL)
+			return;
+		HostBuffer buffer = allocate_host_memory(memory_size, backing);
+		memcpy(buffer.data.get(), contents.get(), memory_size);
+		memory = std::move(buffer.data);
+		page_backing = buffer.backing;
 	}
 
 	inline void UnifiedMemory::load_memory_contents(const shared_ptr<uint8_t[]>& new_memory)
 	{
 		memory = new_memory;
+		page_backing = PageBacking::NORMAL;
 	}
 
 	inline shared_ptr<uint8_t[]>& UnifiedMemory::get_memory_ptr()
@@ -48,6 +73,11 @@ namespace RV32IM
 		return memory;
 	}
 
+	inline PageBacking UnifiedMemory::get_page_backing() const
+	{
+		return page_backing;
+	}
+
 	inline uint32_t UnifiedMemory::read_word(const uint32_t address) const
 	{
 		return *(reinterpret_cast<uint32_t*>(memory.get() + (address & (memory_size - 1))));
@@ -77,4 +107,9 @@ namespace RV32IM
 	{
 		memory[(address & (memory_size - 1))] = data;
 	}
+
+	inline atomic_ref<uint32_t> UnifiedMemory::atomic_word(const uint32_t address) const
+	{
+		return atomic_ref(*(reinterpret_cast<uint32_t*>(memory.get() + (address & (memory_size - 1) & ~3u))));
+	}
 }
@@ -4,9 +4,11 @@
 
 namespace RV32IM
 {
-	VideoInterface::VideoInterface(const shared_ptr<UnifiedMemory>& memory, const unsigned_data video_width, const unsigned_data video_height) :
+	VideoInterface::VideoInterface(const shared_ptr<UnifiedMemory>& memory, const unsigned_data video_width, const unsigned_data video_height,
+		Statistics& statistics) :
 		video_memory_size(video_width * video_height * 4),
 		memory(memory),
+		statistics(statistics),
 		video_memory(new uint8_t[video_memory_size]),
 		temp_buffer(video_height),
 		video_width(video_width),
@@ -28,18 +30,7 @@ namespace RV32IM
 			draw_thread = thread([this]()
 				{
 					while (!halt_drawing)
-					{
-						switch (memory->read_byte(vga_mode))
-						{
-						default:
-						case BITMAP:
-							draw_bitmap();
-							break;
-						case CHARACTER:
-							draw_character();
-							break;
-						}
-					}
+						draw_frame();
 				});
 
 
@@ -56,6 +47,27 @@ namespace RV32IM
 		}
 	}
 
+	void VideoInterface::reset(const shared_ptr<UnifiedMemory>& new_memory)
+	{
+		memory = new_memory;
+		memset(video_memory.get(), 0, video_memory_size);
+	}
+
+	void VideoInterface::draw_frame()
+	{
+		switch (memory->read_byte(vga_mode))
+		{
+		default:
+		case BITMAP:
+			draw_bitmap();
+			break;
+		case CHARACTER:
+			draw_character();
+			break;
+		}
+		statistics.count_frame();
+	}
+
 	shared_ptr<uint8_t[]>& VideoInterface::get_video_memory()
 	{
 		return video_memory;
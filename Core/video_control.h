@@ -4,6 +4,7 @@
 #include <vector>
 
 #include "common.h"
+#include "stats.h"
 #include "unified_memory.h"
 
 namespace RV32IM
@@ -12,9 +13,13 @@ namespace RV32IM
 	class VideoInterface
 	{
 	public:
-		VideoInterface(const shared_ptr<UnifiedMemory>& memory, unsigned_data video_width, unsigned_data video_height);
+		VideoInterface(const shared_ptr<UnifiedMemory>& memory, unsigned_data video_width, unsigned_data video_height, Statistics& statistics);
 		void start_drawing();
 		void stop_drawing();
+		// rebinds to the core's current memory and blanks the frame, drawing must be stopped
+		void reset(const shared_ptr<UnifiedMemory>& new_memory);
+		// renders the current frame on the calling thread, used when single stepping
+		void draw_frame();
 		shared_ptr<uint8_t[]>& get_video_memory();
 
 	private:
@@ -27,6 +32,7 @@ namespace RV32IM
 
 		const unsigned_data video_memory_size;
 		shared_ptr<UnifiedMemory> memory;
+		Statistics& statistics;
 		shared_ptr<uint8_t[]> video_memory;
 		vector<vector<uint32_t>> temp_buffer;
 
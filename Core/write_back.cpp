@@ -9,6 +9,11 @@ namespace RV32IM
 	{
 		WriteBack::WriteBack(Core* main_core): BaseStage(main_core) {}
 
+		void WriteBack::reset()
+		{
+			reg_instruction.reset();
+		}
+
 		void WriteBack::clock()
 		{
 			reg_instruction = core->memory_stage->reg_instruction.read();
@@ -25,21 +30,71 @@ namespace RV32IM
 			case RI:
 			case LUI:
 			case AUIPC:
+			case SYSTEM:
 				write_back_value = core->memory_stage->reg_alu;
 				break;
 			case JALR:
 			case JAL:
-				write_back_value = core->memory_stage->reg_PC + 4;
+				write_back_value = core->memory_stage->reg_PC + instruction.length;
 				break;
 			case LX:
+			case AMO:
 				write_back_value = core->memory_stage->reg_mem_in;
 				break;
 			default:
 				write_back_value = 0xFFFFFFFF;
 				break;
 			}
-			core->register_file->write(instruction.rd, write_back_value);
-			reg_wb_value = write_back_value;
+			if (instruction.has_rd())
+				core->register_file->write(instruction.rd, write_back_value);
+			if (!instruction.bubble)
+			{
+				core->counters->count_retired();
+				if (core->profiler)
+					core->profiler->record_retired(core->memory_stage->reg_PC, instruction, core->memory_stage->reg_alu);
+				// counted at retirement, a watchpoint squash executes the younger instructions again
+				if (core->bbv)
+					core->bbv->on_instruction(core->memory_stage->reg_PC, instruction.opcode == Opcodes::BXX ||
+						instruction.opcode == Opcodes::JAL || instruction.opcode == Opcodes::JALR);
+				if (core->trace_writer || core->lockstep)
+				{
+					const TraceRecord record = make_trace_record(instruction, write_back_value);
+					if (core->trace_writer)
+						core->trace_writer->record(record);
+					if (core->lockstep)
+						core->lockstep->on_retire(record);
+				}
+			}
+		}
+
+		TraceRecord WriteBack::make_trace_record(const Instruction& instruction, const unsigned_data write_back_value) const
+		{
+			TraceRecord record{ core->memory_stage->reg_PC, instruction.inst, 0, 0, 0, static_cast<uint8_t>(instruction.length == 2 ? TRACE_COMPRESSED : 0) };
+			if (instruction.has_rd() && instruction.rd != zero)
+			{
+				record.flags |= TRACE_RD;
+				record.rd_value = write_back_value;
+			}
+			if (instruction.opcode == Opcodes::LX)
+			{
+				record.flags |= TRACE_LOAD;
+				record.memory_address = core->memory_stage->reg_alu;
+				record.memory_data = core->memory_stage->reg_mem_in;
+			}
+			else if (instruction.opcode == Opcodes::SX)
+			{
+				record.flags |= TRACE_STORE;
+				record.memory_address = core->memory_stage->reg_alu;
+				record.memory_data = core->memory_stage->reg_rs2;
+			}
+			else if (instruction.opcode == Opcodes::AMO)
+			{
+				record.flags |= atomic_trace_flags(instruction.inst);
+				record.memory_address = core->memory_stage->reg_alu;
+				// rd already carries the loaded value, so the record keeps the operand
+				record.memory_data = instruction.inst >> 27 == LR_W ? core->memory_stage->reg_mem_in : core->memory_stage->reg_rs2;
+			}
+			return record;
 		}
 	}
 }
@@ -3,6 +3,7 @@
 #include "common.h"
 #include "instruction.h"
 #include "register.h"
+#include "trace.h"
 
 namespace RV32IM
 {
@@ -19,10 +20,12 @@ namespace RV32IM
 			WriteBack(Core* core);
 			void clock() override;
 			void run() override;
+			void reset() override;
 
 		private:
+			[[nodiscard]] TraceRecord make_trace_record(const Instruction& instruction, unsigned_data write_back_value) const;
+
 			Register<Instruction> reg_instruction;
-			Register<unsigned_data> reg_wb_value;
 		};
 	}
 }
@@ -1,5 +1,46 @@
 #include "pch.h"
+#include <filesystem>
+#include <fstream>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "Ws2_32.lib")
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include "../Core/compressed_image.h"
 #include "../Core/core.h"
+#include "../Core/elf_loader.h"
+#include "../Core/fuzzer.h"
+#include "../Core/gdb_server.h"
+#include "../Core/sampling.h"
+#include "../Core/system.h"
+
+// counts every heap allocation in the test binary, so a test can show a path allocates nothing
+std::atomic<uint64_t> heap_allocations = 0;
+
+void* operator new(const size_t size)
+{
+	heap_allocations.fetch_add(1, std::memory_order_relaxed);
+	if (void* pointer = std::malloc(size == 0 ? 1 : size))
+		return pointer;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept
+{
+	std::free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept
+{
+	std::free(pointer);
+}
 
 auto core = RV32IM::Core();
 
@@ -9,3 +50,793 @@ TEST(Core, toggle_clock) {
 	core.stop_clock();
 	EXPECT_FALSE(core.is_clock_running());
 }
+
+TEST(Core, performance_counters) {
+	// csrrs a0, cycle, x0; csrrs a1, instret, x0; jal x0, 0
+	const uint32_t program[] = { 0xC0002573, 0xC02025F3, 0x0000006F };
+	const auto memory = std::shared_ptr<uint8_t[]>(new uint8_t[0x1000]{});
+	memcpy(memory.get(), program, sizeof(program));
+
+	auto counter_core = RV32IM::Core();
+	counter_core.load_memory_contents(memory, 0x1000);
+	for (int i = 0; i < 64; i++)
+		counter_core.step_clock();
+
+	const auto& registers = counter_core.get_registers();
+	EXPECT_EQ(registers[RV32IM::a0], 2);
+	EXPECT_EQ(registers[RV32IM::a1], 0);
+	EXPECT_EQ(counter_core.get_performance_counters().get_cycles(), 64);
+	EXPECT_EQ(counter_core.get_performance_counters().get_instructions_retired(), 60);
+}
+
+TEST(Core, immediate_csr_does_not_stall) {
+	// lw a0, 0x100(zero); csrrsi a1, cycle, 10; jal x0, 0
+	// the uimm names a0, but only the register form csrrs a1, cycle, a0 reads it and waits for the load
+	for (const auto [csr_instruction, stalls] : { std::pair{ 0xC00565F3u, false }, std::pair{ 0xC00525F3u, true } })
+	{
+		const uint32_t program[] = { 0x10002503, csr_instruction, 0x0000006F };
+		const auto memory = std::shared_ptr<uint8_t[]>(new uint8_t[0x1000]{});
+		memcpy(memory.get(), program, sizeof(program));
+
+		auto stall_core = RV32IM::Core();
+		stall_core.load_memory_contents(memory, 0x1000);
+		stall_core.step_clock(16);
+		EXPECT_EQ(stall_core.get_performance_counters().get_stalls() > 0, stalls);
+	}
+}
+
+TEST(Core, run_until_and_step) {
+	// addi a0, a0, 1; jal x0, -4
+	const uint32_t program[] = { 0x00150513, 0xFFDFF06F, 0x0000006F };
+	const auto memory = std::shared_ptr<uint8_t[]>(new uint8_t[0x1000]{});
+	memcpy(memory.get(), program, sizeof(program));
+
+	auto control_core = RV32IM::Core();
+	control_core.load_memory_contents(memory, 0x1000);
+	control_core.step_clock(10);
+	EXPECT_EQ(control_core.get_performance_counters().get_cycles(), 10);
+
+	control_core.run_until(0x4);
+	for (int i = 0; i < 1000 && control_core.is_clock_running(); i++)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	control_core.stop_clock();
+	EXPECT_TRUE(control_core.get_run_state() == RV32IM::RunState::PAUSED);
+	EXPECT_EQ(control_core.get_current_address(), 0x4);
+}
+
+TEST(Core, breakpoints_and_watchpoints) {
+	// addi a0, a0, 1; sw a0, 0x100(zero); jal x0, -8
+	const uint32_t program[] = { 0x00150513, 0x10A02023, 0xFF9FF06F };
+	const auto memory = std::shared_ptr<uint8_t[]>(new uint8_t[0x1000]{});
+	memcpy(memory.get(), program, sizeof(program));
+
+	auto debug_core = RV32IM::Core();
+	debug_core.load_memory_contents(memory, 0x1000);
+	const auto wait_for_stop = [&]
+	{
+		for (int i = 0; i < 1000 && debug_core.is_clock_running(); i++)
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		debug_core.stop_clock();
+	};
+	const auto stored = [&] { return *reinterpret_cast<uint32_t*>(debug_core.get_memory_ptr().get() + 0x100); };
+
+	debug_core.add_breakpoint(0x4);
+	for (uint32_t iteration = 1; iteration <= 3; iteration++)
+	{
+		debug_core.start_clock();
+		wait_for_stop();
+		EXPECT_TRUE(debug_core.get_stop_info().reason == RV32IM::StopReason::BREAKPOINT);
+		EXPECT_EQ(debug_core.get_stop_info().pc, 0x4);
+		EXPECT_EQ(debug_core.get_registers()[RV32IM::a0], iteration);
+		EXPECT_EQ(stored(), iteration - 1);
+	}
+
+	debug_core.remove_breakpoint(0x4);
+	debug_core.add_watchpoint(0x100, 4, RV32IM::WATCH_WRITE);
+	debug_core.start_clock();
+	wait_for_stop();
+	EXPECT_TRUE(debug_core.get_stop_info().reason == RV32IM::StopReason::WATCHPOINT);
+	EXPECT_EQ(debug_core.get_stop_info().pc, 0x8);
+	// the store still pending at the last breakpoint is the first one to hit
+	EXPECT_EQ(debug_core.get_registers()[RV32IM::a0], 3);
+	EXPECT_EQ(stored(), 3);
+}
+
+TEST(Core, step_instruction_and_set_pc) {
+	// addi a0, a0, 1; jal x0, -4
+	const uint32_t program[] = { 0x00150513, 0xFFDFF06F };
+	const auto memory = std::shared_ptr<uint8_t[]>(new uint8_t[0x1000]{});
+	memcpy(memory.get(), program, sizeof(program));
+
+	auto debug_core = RV32IM::Core();
+	debug_core.load_memory_contents(memory, 0x1000);
+	debug_core.step_instruction();
+	EXPECT_EQ(debug_core.get_current_address(), 0x4);
+	EXPECT_EQ(debug_core.get_registers()[RV32IM::a0], 1);
+	debug_core.step_instruction();
+	EXPECT_EQ(debug_core.get_current_address(), 0x0);
+
+	debug_core.set_register(RV32IM::a0, 41);
+	debug_core.set_pc(0x0);
+	debug_core.step_instruction();
+	EXPECT_EQ(debug_core.get_registers()[RV32IM::a0], 42);
+	EXPECT_EQ(debug_core.get_performance_counters().get_instructions_retired(), 3);
+}
+
+// minimal remote serial protocol client, acknowledges every reply like gdb does before no-ack mode
+class GdbClient
+{
+public:
+	explicit GdbClient(const uint16_t port)
+	{
+		socket_handle = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+		sockaddr_in address{};
+		address.sin_family = AF_INET;
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		address.sin_port = htons(port);
+		connected = connect(socket_handle, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0;
+	}
+
+	~GdbClient()
+	{
+#ifdef _WIN32
+		closesocket(socket_handle);
+#else
+		close(socket_handle);
+#endif
+	}
+
+	std::string exchange(const std::string& packet)
+	{
+		uint8_t checksum = 0;
+		for (const char character : packet)
+			checksum += static_cast<uint8_t>(character);
+		char trailer[4];
+		snprintf(trailer, sizeof(trailer), "#%02x", checksum);
+		const std::string frame = "$" + packet + trailer;
+		send(socket_handle, frame.data(), static_cast<int>(frame.size()), 0);
+
+		char character;
+		while (recv(socket_handle, &character, 1, 0) == 1 && character != '$') {}
+		std::string reply;
+		while (recv(socket_handle, &character, 1, 0) == 1 && character != '#')
+			reply += character;
+		char received_checksum[2];
+		recv(socket_handle, received_checksum, 1, 0);
+		recv(socket_handle, received_checksum + 1, 1, 0);
+		send(socket_handle, "+", 1, 0);
+		return reply;
+	}
+
+	bool connected;
+
+private:
+#ifdef _WIN32
+	SOCKET socket_handle;
+#else
+	int socket_handle;
+#endif
+};
+
+TEST(Core, gdb_server_loopback) {
+	// addi a0, a0, 1; jal x0, -4
+	const uint32_t program[] = { 0x00150513, 0xFFDFF06F };
+	const auto memory = std::shared_ptr<uint8_t[]>(new uint8_t[0x1000]{});
+	memcpy(memory.get(), program, sizeof(program));
+
+	auto debug_core = RV32IM::Core();
+	debug_core.load_memory_contents(memory, 0x1000);
+	RV32IM::GdbServer server(debug_core, 0);
+	{
+		GdbClient client(server.get_port());
+		ASSERT_TRUE(client.connected);
+		EXPECT_EQ(client.exchange("?"), "S05");
+		// x0-x31 then pc, 8 little endian hex digits each
+		std::string registers = client.exchange("g");
+		ASSERT_EQ(registers.size(), 33 * 8);
+		EXPECT_EQ(registers.substr(RV32IM::a0 * 8, 8), "00000000");
+		EXPECT_EQ(client.exchange("m0,8"), "130515006ff0dfff");
+
+		// inserting twice still leaves a single breakpoint for one remove to clear
+		EXPECT_EQ(client.exchange("Z0,4,4"), "OK");
+		EXPECT_EQ(client.exchange("Z0,4,4"), "OK");
+		EXPECT_EQ(client.exchange("c"), "T05swbreak:;");
+		registers = client.exchange("g");
+		EXPECT_EQ(registers.substr(RV32IM::a0 * 8, 8), "01000000");
+		EXPECT_EQ(registers.substr(32 * 8, 8), "04000000");
+		EXPECT_EQ(client.exchange("z0,4,4"), "OK");
+		EXPECT_EQ(debug_core.get_debug_points(), nullptr);
+
+		EXPECT_EQ(client.exchange("D"), "OK");
+	}
+	while (server.is_attached())
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	// the core was paused when the debugger attached, so detaching leaves it paused
+	EXPECT_FALSE(debug_core.is_clock_running());
+}
+
+TEST(Core, huge_page_backing) {
+	// addi a0, a0, 1; jal x0, -4 in 4 MiB of guest memory
+	const uint32_t program[] = { 0x00150513, 0xFFDFF06F };
+	const size_t memory_size = 2 * RV32IM::HUGE_PAGE_SIZE;
+	const auto memory = std::shared_ptr<uint8_t[]>(new uint8_t[memory_size]{});
+	memcpy(memory.get(), program, sizeof(program));
+
+	auto debug_core = RV32IM::Core();
+	debug_core.set_page_backing(RV32IM::PageBacking::TRANSPARENT);
+	debug_core.load_memory_contents(memory, memory_size);
+	EXPECT_FALSE(debug_core.get_page_backing() == RV32IM::PageBacking::EXPLICIT);
+	// the image is copied, so the core runs from its own buffer
+	EXPECT_NE(debug_core.get_memory_ptr().get(), memory.get());
+	if (debug_core.get_page_backing() == RV32IM::PageBacking::TRANSPARENT)
+	{
+		EXPECT_EQ(reinterpret_cast<uintptr_t>(debug_core.get_memory_ptr().get()) % RV32IM::HUGE_PAGE_SIZE, 0);
+	}
+	debug_core.step_instruction();
+	EXPECT_EQ(debug_core.get_registers()[RV32IM::a0], 1);
+
+	// tables are built like the predictor's, assigned from a temporary that carries the configured backing
+	RV32IM::HugePageVector<uint32_t> table;
+	table = RV32IM::HugePageVector<uint32_t>(RV32IM::HUGE_PAGE_SIZE, 0, RV32IM::PageBacking::TRANSPARENT);
+	EXPECT_TRUE(table.get_allocator().get_backing() == RV32IM::PageBacking::TRANSPARENT);
+	table.back() = 1;
+	EXPECT_EQ(table.front() + table.back(), 1);
+}
+
+TEST(Core, reset_in_place) {
+	// addi a0, a0, 1; jal x0, -4
+	const uint32_t program[] = { 0x00150513, 0xFFDFF06F };
+	const auto memory = std::shared_ptr<uint8_t[]>(new uint8_t[0x1000]{});
+	memcpy(memory.get(), program, sizeof(program));
+
+	auto reset_core = RV32IM::Core();
+	reset_core.load_memory_contents(memory, 0x1000);
+	for (int i = 0; i < 64; i++)
+		reset_core.step_clock();
+	const RV32IM::unsigned_data first_run = reset_core.get_registers()[RV32IM::a0];
+	ASSERT_NE(first_run, 0);
+	const uint8_t* frame = reset_core.get_video_memory().get();
+
+	constexpr int resets = 10000;
+	const uint64_t allocations = heap_allocations.load();
+	const auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < resets; i++)
+		reset_core.reset();
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	EXPECT_EQ(heap_allocations.load(), allocations);
+	RecordProperty("resets_per_second", static_cast<int>(resets / seconds));
+
+	EXPECT_EQ(reset_core.get_video_memory().get(), frame);
+	EXPECT_EQ(reset_core.get_registers()[RV32IM::a0], 0);
+	EXPECT_EQ(reset_core.get_performance_counters().get_cycles(), 0);
+	EXPECT_EQ(reset_core.get_branch_predictor().get_hits() + reset_core.get_branch_predictor().get_misses(), 0);
+	// the pipeline restarts from pc 0 just like after a load
+	for (int i = 0; i < 64; i++)
+		reset_core.step_clock();
+	EXPECT_EQ(reset_core.get_registers()[RV32IM::a0], first_run);
+}
+
+TEST(ElfLoader, loads_segments_and_symbols) {
+	// _start: addi a0, a0, 1; jal x0, -4 at 0x100, counter in .bss at 0x200
+	const auto elf_path = std::filesystem::path(__FILE__).parent_path() / "elf_test.elf";
+	const RV32IM::ProgramImage image = RV32IM::ElfLoader::load(elf_path.string());
+	EXPECT_EQ(image.memory_size, 0x100000);
+	EXPECT_EQ(image.entry_point, 0x100);
+	EXPECT_EQ(*reinterpret_cast<const uint32_t*>(image.memory.get() + 0x100), 0x00150513);
+	EXPECT_EQ(*reinterpret_cast<const uint32_t*>(image.memory.get() + 0x200), 0);
+	EXPECT_EQ(image.symbols.find("_start"), 0x100);
+	EXPECT_EQ(image.symbols.find("counter"), 0x200);
+
+	auto elf_core = RV32IM::Core();
+	elf_core.load_elf(elf_path.string());
+	elf_core.step_instruction();
+	EXPECT_EQ(elf_core.get_registers()[RV32IM::a0], 1);
+	EXPECT_EQ(elf_core.get_symbols().describe(elf_core.get_current_address()), "_start+4");
+
+	std::ifstream file(elf_path, std::ios::binary);
+	const std::vector<char> contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	const auto corrupt_path = std::filesystem::temp_directory_path() / "rv32im_elf_test.elf";
+	const auto load_patched = [&](const size_t offset, const uint32_t value, const size_t size, const size_t memory_size = 0)
+		{
+			std::vector<char> patched = contents;
+			memcpy(patched.data() + offset, &value, size);
+			std::ofstream(corrupt_path, std::ios::binary).write(patched.data(), static_cast<std::streamsize>(patched.size()));
+			RV32IM::ElfLoader::load(corrupt_path.string(), memory_size);
+		};
+	// x86-64 machine, a string table far past the end of the file, and a segment reaching into the I/O registers
+	EXPECT_THROW(load_patched(18, 0x3E, 2), RV32IM::ElfLoadError);
+	EXPECT_THROW(load_patched(192 + 3 * 40 + 20, 0x7FFFFFFF, 4), RV32IM::ElfLoadError);
+	EXPECT_THROW(load_patched(52 + 8, 0xFFEF0, 4, 0x100000), RV32IM::ElfLoadError);
+	{
+		std::ofstream(corrupt_path, std::ios::binary).write(contents.data(), 40);
+	}
+	EXPECT_THROW(RV32IM::ElfLoader::load(corrupt_path.string()), RV32IM::ElfLoadError);
+	std::filesystem::remove(corrupt_path);
+}
+
+TEST(CompressedImageLoader, round_trip_and_corrupt_input) {
+	// written by lz4 with linked 64 KiB blocks and every checksum, so it spans two blocks
+	const auto image_path = std::filesystem::path(__FILE__).parent_path() / "compressed_test.lz4";
+	constexpr size_t memory_size = 0x20000;
+	std::vector<uint8_t> expected(memory_size, 0);
+	for (size_t i = 0; i < 0x8000; i++)
+		expected[i] = static_cast<uint8_t>(i * 7 + (i >> 9));
+	const uint32_t stored_size = memory_size;
+	memcpy(expected.data() + 0x30, &stored_size, sizeof(stored_size));
+
+	ASSERT_TRUE(RV32IM::CompressedImageLoader::is_compressed_image(image_path.string()));
+	const RV32IM::ProgramImage image = RV32IM::CompressedImageLoader::load(image_path.string());
+	ASSERT_EQ(image.memory_size, memory_size);
+	EXPECT_EQ(memcmp(image.memory.get(), expected.data(), memory_size), 0);
+
+	std::ifstream file(image_path, std::ios::binary);
+	const std::vector<char> contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	const auto corrupt_path = std::filesystem::temp_directory_path() / "rv32im_compressed_test.lz4";
+	const auto load_corrupt = [&](const size_t offset, const size_t size)
+		{
+			std::vector<char> corrupt(contents.begin(), contents.begin() + static_cast<std::ptrdiff_t>(size));
+			if (offset < size)
+				corrupt[offset] ^= 0x01;
+			std::ofstream(corrupt_path, std::ios::binary).write(corrupt.data(), static_cast<std::streamsize>(corrupt.size()));
+			RV32IM::CompressedImageLoader::load(corrupt_path.string());
+		};
+	// header checksum, a byte of the first block, the content checksum, then a truncated frame
+	EXPECT_THROW(load_corrupt(14, contents.size()), RV32IM::CompressedImageError);
+	EXPECT_THROW(load_corrupt(40, contents.size()), RV32IM::CompressedImageError);
+	EXPECT_THROW(load_corrupt(contents.size() - 1, contents.size()), RV32IM::CompressedImageError);
+	EXPECT_THROW(load_corrupt(contents.size(), contents.size() - 8), RV32IM::CompressedImageError);
+	std::filesystem::remove(corrupt_path);
+}
+
+TEST(Core, compressed_instructions) {
+	// c.li a0, 5; c.jal 4; c.addi a0, 1; addi a0, a0, 1 on a halfword boundary; c.nop
+	const uint16_t program[] = { 0x4515, 0x2011, 0x0505, 0x0513, 0x0015, 0x0001 };
+	const auto memory = std::shared_ptr<uint8_t[]>(new uint8_t[0x1000]{});
+	memcpy(memory.get(), program, sizeof(program));
+
+	auto debug_core = RV32IM::Core();
+	debug_core.load_memory_contents(memory, 0x1000);
+	debug_core.step_instruction();
+	EXPECT_EQ(debug_core.get_current_address(), 0x2);
+	debug_core.step_instruction();
+	EXPECT_EQ(debug_core.get_current_address(), 0x6);
+	EXPECT_EQ(debug_core.get_registers()[RV32IM::ra], 0x4);
+	debug_core.step_instruction();
+	EXPECT_EQ(debug_core.get_current_address(), 0xA);
+	EXPECT_EQ(debug_core.get_registers()[RV32IM::a0], 6);
+}
+
+TEST(Core, decode_tables) {
+	// sub a0, a0, a1; srai a0, a0, 1; mulhu a0, a0, a1; bne a0, a1, -4
+	EXPECT_TRUE(RV32IM::Stage::Fetch::parse_instruction(0x40B50533).operation == RV32IM::Operation::SUB);
+	EXPECT_TRUE(RV32IM::Stage::Fetch::parse_instruction(0x40155513).operation == RV32IM::Operation::SRA);
+	EXPECT_TRUE(RV32IM::Stage::Fetch::parse_instruction(0x02B53533).operation == RV32IM::Operation::MULHU);
+	const auto branch = RV32IM::Stage::Fetch::parse_instruction(0xFEB51EE3);
+	EXPECT_TRUE(branch.operation == RV32IM::Operation::BNE);
+	EXPECT_EQ(branch.immediate, 0xFFFFFFFC);
+	// reserved funct7 on an R-type and ld, which only exists on RV64
+	EXPECT_TRUE(RV32IM::Stage::Fetch::parse_instruction(0x08B50533).bubble);
+	EXPECT_TRUE(RV32IM::Stage::Fetch::parse_instruction(0x0000B003).bubble);
+}
+
+TEST(Trace, round_trip_and_corrupt_input) {
+	const auto path = std::filesystem::temp_directory_path() / "rv32im_trace_test.trace";
+	// sequential, backwards jump, compressed, register write, load and store records over several small chunks
+	std::vector<RV32IM::TraceRecord> records;
+	for (uint32_t i = 0; i < 200; i++)
+	{
+		const RV32IM::unsigned_data pc = i % 7 == 0 ? 0x80 + i * 8 : 0x1000 + i * 4;
+		const uint8_t flags = static_cast<uint8_t>(i % 5 == 0 ? RV32IM::TRACE_RD | RV32IM::TRACE_COMPRESSED :
+			i % 5 == 1 ? RV32IM::TRACE_LOAD | RV32IM::TRACE_RD : i % 5 == 2 ? RV32IM::TRACE_STORE : 0);
+		records.push_back({ pc, 0x00150513 + i, i * 0x10001, 0x4000 - i * 12, 0xDEADBEEF ^ i, flags });
+	}
+	{
+		RV32IM::TraceWriter writer(path.string(), 64);
+		for (const auto& record : records)
+			writer.record(record);
+		writer.flush();
+	}
+
+	{
+		RV32IM::TraceReader reader(path.string());
+		RV32IM::TraceRecord record{};
+		for (const auto& expected : records)
+		{
+			ASSERT_TRUE(reader.next(record));
+			EXPECT_EQ(record.pc, expected.pc);
+			EXPECT_EQ(record.inst, expected.inst);
+			EXPECT_EQ(record.flags, expected.flags);
+			EXPECT_EQ(record.rd_value, expected.flags & RV32IM::TRACE_RD ? expected.rd_value : 0);
+			if (expected.flags & (RV32IM::TRACE_LOAD | RV32IM::TRACE_STORE))
+			{
+				EXPECT_EQ(record.memory_address, expected.memory_address);
+				EXPECT_EQ(record.memory_data, expected.memory_data);
+			}
+		}
+		EXPECT_FALSE(reader.next(record));
+	}
+
+	const auto read_all = [&]
+		{
+			RV32IM::TraceReader reader(path.string());
+			RV32IM::TraceRecord record{};
+			while (reader.next(record)) {}
+		};
+	// a truncated file and a chunk claiming 4 GiB of payload are both reported, neither reads past the end
+	std::filesystem::resize_file(path, std::filesystem::file_size(path) - 3);
+	EXPECT_THROW(read_all(), RV32IM::TraceError);
+	{
+		std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+		const uint32_t huge_size = 0xFFFFFFFF;
+		file.seekp(8 + 8);
+		file.write(reinterpret_cast<const char*>(&huge_size), sizeof(huge_size));
+	}
+	EXPECT_THROW(read_all(), RV32IM::TraceError);
+	// a chunk whose record count outruns its payload
+	{
+		std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+		const uint32_t header[2] = { 1000, 8 };
+		file.seekp(8 + 4);
+		file.write(reinterpret_cast<const char*>(header), sizeof(header));
+	}
+	EXPECT_THROW(read_all(), RV32IM::TraceError);
+	std::filesystem::remove(path);
+}
+
+TEST(Cache, lru_eviction_and_stalls) {
+	// one set of two 32 byte lines
+	auto cache = RV32IM::Cache({ 64, 32, 2, RV32IM::ReplacementPolicy::LRU });
+	bool writeback;
+	uint32_t victim;
+	EXPECT_FALSE(cache.access(0x000, true, writeback, victim));
+	EXPECT_FALSE(cache.access(0x100, false, writeback, victim));
+	EXPECT_TRUE(cache.access(0x104, false, writeback, victim));
+	EXPECT_FALSE(cache.access(0x200, false, writeback, victim));
+	EXPECT_TRUE(writeback);
+	EXPECT_EQ(victim, 0x000);
+	EXPECT_TRUE(cache.access(0x100, false, writeback, victim));
+	EXPECT_EQ(cache.get_writebacks(), 1);
+
+	// lw a0, 0x100(zero); lw a1, 0x104(zero); jal x0, 0
+	const uint32_t program[] = { 0x10002503, 0x10402583, 0x0000006F };
+	const auto memory = std::shared_ptr<uint8_t[]>(new uint8_t[0x1000]{});
+	memcpy(memory.get(), program, sizeof(program));
+	memory[0x100] = 7;
+	memory[0x104] = 9;
+
+	auto cached_core = RV32IM::Core();
+	cached_core.load_memory_contents(memory, 0x1000);
+	const RV32IM::CacheHierarchyConfig config;
+	cached_core.enable_caches(config);
+	cached_core.step_clock(200);
+	const RV32IM::CacheHierarchy* caches = cached_core.get_caches();
+	EXPECT_EQ(caches->get_l1i().get_misses(), 1);
+	EXPECT_EQ(caches->get_l1d().get_misses(), 1);
+	EXPECT_EQ(caches->get_l1d().get_hits(), 1);
+	// the first fetch and the first load both go all the way to memory
+	EXPECT_EQ(caches->get_stall_cycles(), 2 * (config.l2_latency + config.memory_latency));
+	EXPECT_EQ(cached_core.get_registers()[RV32IM::a0], 7);
+	EXPECT_EQ(cached_core.get_registers()[RV32IM::a1], 9);
+}
+
+TEST(Sampling, matches_detailed_cpi) {
+	// lui a1, 0x80; loop: addi a0, a0, 1; bne a0, a1, loop; jal x0, 0
+	const uint32_t program[] = { 0x000805B7, 0x00150513, 0xFEB51EE3, 0x0000006F };
+	const auto memory = std::shared_ptr<uint8_t[]>(new uint8_t[0x1000]{});
+	memcpy(memory.get(), program, sizeof(program));
+
+	auto detailed_core = RV32IM::Core();
+	detailed_core.load_memory_contents(memory, 0x1000);
+	while (detailed_core.get_performance_counters().get_instructions_retired() < 100000)
+		detailed_core.step_clock();
+	const double detailed_cpi = static_cast<double>(detailed_core.get_performance_counters().get_cycles()) / 100000.0;
+
+	auto sampled_core = RV32IM::Core();
+	sampled_core.load_memory_contents(memory, 0x1000);
+	auto sampler = RV32IM::SampledSimulation(sampled_core, { 20000, 5000, 500, 2000 });
+	const RV32IM::SamplingResult result = sampler.run(100000);
+	EXPECT_EQ(result.instructions, 100000);
+	EXPECT_EQ(result.sample_cpi.size(), 4);
+	EXPECT_NEAR(result.cpi, detailed_cpi, 0.05);
+	EXPECT_LT(result.confidence, 0.05);
+	// every instruction ran exactly once across both engines
+	EXPECT_EQ(sampled_core.get_registers()[RV32IM::a0], 50000);
+}
+
+TEST(Interpreter, fused_pairs_match_step) {
+	// lui+addi; li t0, 4; loop: slli+add, addi+bnez; auipc+jalr; spin
+	const uint32_t program[] = { 0x12345537, 0x67850513, 0x00400293, 0x00229313, 0x006585B3, 0xFFF28293, 0xFE029AE3,
+		0x00000397, 0x008380E7, 0x0000006F };
+	const auto stepped_memory = std::make_shared<RV32IM::UnifiedMemory>(0x1000);
+	const auto fused_memory = std::make_shared<RV32IM::UnifiedMemory>(0x1000);
+	memcpy(stepped_memory->get_memory_ptr().get(), program, sizeof(program));
+	memcpy(fused_memory->get_memory_ptr().get(), program, sizeof(program));
+
+	RV32IM::Interpreter stepped(stepped_memory, 0);
+	RV32IM::Interpreter fused(fused_memory, 0);
+	for (int i = 0; i < 21; i++)
+		stepped.step();
+	EXPECT_EQ(fused.run(21), 11);
+	EXPECT_EQ(fused.get_pc(), 0x24);
+	EXPECT_EQ(fused.get_pc(), stepped.get_pc());
+	EXPECT_TRUE(fused.get_registers() == stepped.get_registers());
+	EXPECT_EQ(fused.get_registers()[RV32IM::a0], 0x12345678);
+	EXPECT_EQ(fused.get_registers()[RV32IM::a1], 40);
+}
+
+TEST(Profiler, per_pc_counts_and_call_stacks) {
+	// 0x00: jal ra, 0x10; jal x0, -4; nop; nop
+	// 0x10: jal t0, 0x20; jalr zero, 0(ra); nop; nop
+	// 0x20: addi a0, a0, 1; jalr zero, 0(t0)
+	const uint32_t program[] = { 0x010000EF, 0xFFDFF06F, 0x00000013, 0x00000013, 0x010002EF, 0x00008067, 0x00000013,
+	                             0x00000013, 0x00150513, 0x00028067 };
+	const auto memory = std::shared_ptr<uint8_t[]>(new uint8_t[0x1000]{});
+	memcpy(memory.get(), program, sizeof(program));
+
+	auto profiled_core = RV32IM::Core();
+	profiled_core.load_memory_contents(memory, 0x1000);
+	profiled_core.enable_profiler(true);
+	profiled_core.step_clock(1000);
+
+	const auto calls = profiled_core.get_registers()[RV32IM::a0];
+	const auto& flat = profiled_core.get_profiler()->get_flat_profile();
+	ASSERT_NE(flat.find(0x20), nullptr);
+	ASSERT_NE(flat.find(0x00), nullptr);
+	EXPECT_GT(calls, 10);
+	EXPECT_EQ(flat.find(0x20)->instructions, calls);
+	EXPECT_NEAR(static_cast<double>(flat.find(0x00)->instructions), calls, 1);
+	EXPECT_EQ(flat.find(0x08), nullptr);
+
+	// calls and returns through t0 nest exactly like those through ra
+	std::stringstream folded;
+	profiled_core.get_profiler()->write_folded(folded);
+	std::string root, caller, callee, extra;
+	std::getline(folded, root);
+	std::getline(folded, caller);
+	std::getline(folded, callee);
+	EXPECT_TRUE(root.starts_with("root "));
+	EXPECT_TRUE(caller.starts_with("root;0x00000010 "));
+	EXPECT_EQ(callee, "root;0x00000010;0x00000020 " + std::to_string(flat.find(0x20)->instructions + flat.find(0x24)->instructions));
+	EXPECT_FALSE(std::getline(folded, extra));
+}
+
+TEST(Core, basic_block_vectors) {
+	// lui a1, 0x1; loop: addi a0, a0, 1; bne a0, a1, loop; jal x0, 0
+	const uint32_t program[] = { 0x000015B7, 0x00150513, 0xFEB51EE3, 0x0000006F };
+	const auto memory = std::shared_ptr<uint8_t[]>(new uint8_t[0x1000]{});
+	memcpy(memory.get(), program, sizeof(program));
+
+	auto bbv_core = RV32IM::Core();
+	bbv_core.load_memory_contents(memory, 0x1000);
+	const auto path = std::filesystem::temp_directory_path() / "rv32im_bbv_test.bb";
+	bbv_core.start_bbv(path.string(), 1000);
+	bbv_core.step_clock(3000);
+	bbv_core.stop_bbv();
+
+	std::string first, second;
+	{
+		std::ifstream file(path);
+		std::getline(file, first);
+		std::getline(file, second);
+	}
+	std::filesystem::remove(path);
+	// the first block runs from the entry through the first bne, the loop body is the second
+	EXPECT_EQ(first, "T:1:3 :2:998 ");
+	EXPECT_EQ(second, "T:2:1000 ");
+	EXPECT_THROW(bbv_core.start_bbv((path / "missing" / "test.bb").string()), RV32IM::BbvError);
+
+	// a watchpoint squashes and refetches the instructions behind the store, they still count once
+	// addi a0, a0, 1; sw a0, 0x100(zero); jal x0, -8
+	const uint32_t store_loop[] = { 0x00150513, 0x10A02023, 0xFF9FF06F };
+	memset(memory.get(), 0, 0x1000);
+	memcpy(memory.get(), store_loop, sizeof(store_loop));
+	auto watched_core = RV32IM::Core();
+	watched_core.load_memory_contents(memory, 0x1000);
+	watched_core.start_bbv(path.string(), 1000);
+	watched_core.step_clock(50);
+	watched_core.add_watchpoint(0x100, 4, RV32IM::WATCH_WRITE);
+	watched_core.start_clock();
+	for (int i = 0; i < 1000 && watched_core.is_clock_running(); i++)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	watched_core.stop_clock();
+	watched_core.stop_bbv();
+
+	uint64_t counted = 0;
+	{
+		std::ifstream file(path);
+		std::string line;
+		while (std::getline(file, line))
+		{
+			// T:<id>:<count> :<id>:<count> ...
+			std::istringstream fields(line.substr(1));
+			char separator;
+			uint64_t id, count;
+			while (fields >> separator >> id >> separator >> count)
+				counted += count;
+		}
+	}
+	std::filesystem::remove(path);
+	EXPECT_TRUE(watched_core.get_stop_info().reason == RV32IM::StopReason::WATCHPOINT);
+	EXPECT_EQ(counted, watched_core.get_performance_counters().get_instructions_retired());
+}
+
+TEST(Core, statistics_snapshots_and_export) {
+	// addi a0, a0, 1; jal x0, -4
+	const uint32_t program[] = { 0x00150513, 0xFFDFF06F };
+	const auto memory = std::shared_ptr<uint8_t[]>(new uint8_t[0x1000]{});
+	memcpy(memory.get(), program, sizeof(program));
+
+	auto stats_core = RV32IM::Core();
+	stats_core.load_memory_contents(memory, 0x1000);
+	stats_core.step_clock(100);
+	const RV32IM::StatsSnapshot first = stats_core.get_stats_snapshot();
+	EXPECT_EQ(first.cycles, 100);
+	stats_core.step_clock(50);
+	const RV32IM::StatsSnapshot difference = stats_core.get_stats_snapshot().since(first);
+	EXPECT_EQ(difference.cycles, 50);
+	EXPECT_EQ(difference.instructions_retired, stats_core.get_performance_counters().get_instructions_retired() - first.instructions_retired);
+	// step_clock draws one frame per call
+	EXPECT_EQ(difference.frames, 1);
+
+	// the exporter writes a final line when it stops, with the instance label escaped
+	const auto path = std::filesystem::temp_directory_path() / "rv32im_stats_test.jsonl";
+	stats_core.start_stats_export(path.string(), RV32IM::StatsFormat::JSON_LINES, std::chrono::milliseconds(3600000), "te\"st");
+	stats_core.stop_stats_export();
+	std::string line;
+	{
+		std::ifstream file(path);
+		std::getline(file, line);
+	}
+	EXPECT_NE(line.find("\"instance\":\"te\\\"st\",\"cycles\":150,"), std::string::npos);
+
+	stats_core.start_stats_export(path.string(), RV32IM::StatsFormat::PROMETHEUS, std::chrono::milliseconds(3600000), "a\\b");
+	stats_core.stop_stats_export();
+	{
+		std::ifstream file(path);
+		const std::string contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		EXPECT_NE(contents.find("rv32_cycles_total{instance=\"a\\\\b\"} 150\n"), std::string::npos);
+	}
+	std::filesystem::remove(path);
+	EXPECT_THROW(stats_core.start_stats_export((path / "missing" / "stats.jsonl").string(), RV32IM::StatsFormat::JSON_LINES),
+		RV32IM::StatsError);
+}
+
+TEST(System, harts_share_memory) {
+	// csrr a0, mhartid; slli a1, a0, 2; addi a0, a0, 1; sw a0, 0x100(a1); jal x0, 0
+	const uint32_t program[] = { 0xF1402573, 0x00251593, 0x00150513, 0x10A5A023, 0x0000006F };
+	const auto memory = std::shared_ptr<uint8_t[]>(new uint8_t[0x1000]{});
+	memcpy(memory.get(), program, sizeof(program));
+	const auto slot = [](const RV32IM::System& system, const size_t hart)
+	{
+		return *reinterpret_cast<uint32_t*>(system.get_memory_ptr().get() + 0x100 + hart * 4);
+	};
+
+	auto system = RV32IM::System(4);
+	system.load_memory_contents(memory, 0x1000);
+	EXPECT_TRUE(system.run_round_robin(100, 7));
+	for (size_t hart = 0; hart < 4; hart++)
+	{
+		EXPECT_EQ(slot(system, hart), hart + 1);
+		EXPECT_EQ(system.get_hart(hart).get_performance_counters().get_cycles(), 100);
+	}
+
+	system.reset();
+	memset(system.get_memory_ptr().get() + 0x100, 0, 16);
+	system.start();
+	const auto all_written = [&]
+	{
+		for (size_t hart = 0; hart < 4; hart++)
+			if (slot(system, hart) == 0)
+				return false;
+		return true;
+	};
+	for (int i = 0; i < 1000 && !all_written(); i++)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	system.stop();
+	EXPECT_FALSE(system.is_running());
+	for (size_t hart = 0; hart < 4; hart++)
+		EXPECT_EQ(slot(system, hart), hart + 1);
+}
+
+TEST(System, atomics_between_harts) {
+	// 1000 times: amoadd.w on 0x100, then an lr.w/sc.w retry loop incrementing 0x104; finally amoadd.w on 0x108 and spin
+	const uint32_t program[] = { 0x3E800293, 0x10000313, 0x10400E13, 0x00100E93, 0x01D3202F, 0x100E252F, 0x00150513, 0x18AE25AF,
+		0xFE059AE3, 0xFFF28293, 0xFE0294E3, 0x10800F13, 0x01DF202F, 0x0000006F };
+	const auto memory = std::shared_ptr<uint8_t[]>(new uint8_t[0x1000]{});
+	memcpy(memory.get(), program, sizeof(program));
+	const auto word = [](const RV32IM::System& system, const uint32_t address)
+	{
+		return *reinterpret_cast<uint32_t*>(system.get_memory_ptr().get() + address);
+	};
+
+	auto system = RV32IM::System(4);
+	system.load_memory_contents(memory, 0x1000);
+	system.start();
+	for (int i = 0; i < 5000 && word(system, 0x108) != 4; i++)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	system.stop();
+	EXPECT_EQ(word(system, 0x108), 4);
+	EXPECT_EQ(word(system, 0x100), 4000);
+	EXPECT_EQ(word(system, 0x104), 4000);
+}
+
+TEST(BranchPredictor, learns_taken_branch) {
+	for (const auto type : { RV32IM::PredictorType::STATIC, RV32IM::PredictorType::BIMODAL, RV32IM::PredictorType::GSHARE,
+	                         RV32IM::PredictorType::LOCAL, RV32IM::PredictorType::TAGE })
+	{
+		const auto predictor = RV32IM::make_branch_predictor({ type });
+		for (int i = 0; i < 16; i++)
+		{
+			predictor->record_prediction(predictor->take_branch(0x100, 0x80));
+			predictor->update_table(0x100, true);
+		}
+		EXPECT_TRUE(predictor->take_branch(0x100, 0x80));
+		EXPECT_GT(predictor->get_hits(), 0);
+	}
+}
+
+TEST(BranchPredictor, local_history_indexing_and_size) {
+	for (const size_t tag_bits : { static_cast<size_t>(0), static_cast<size_t>(8), static_cast<size_t>(12) })
+	{
+		const auto predictor = RV32IM::make_branch_predictor({ RV32IM::PredictorType::LOCAL, 4096, tag_bits });
+		// 2 bit counters packed 4 to a byte, a byte per tag up to 8 bits and two above, a byte of history per 4 counters
+		const size_t tag_bytes = tag_bits == 0 ? 0 : tag_bits <= 8 ? 1 : 2;
+		EXPECT_EQ(predictor->get_table_size(), 4096 / 4 + 4096 * tag_bytes + 4096 / 4);
+
+		for (int i = 0; i < 16; i++)
+			predictor->update_table(0x100, true);
+		EXPECT_TRUE(predictor->take_branch(0x100, 0x80));
+		// the next branch has a history of its own
+		EXPECT_FALSE(predictor->take_branch(0x104, 0x80));
+		// 0x4110 folds onto the same history and counters, only a tag tells it apart
+		EXPECT_EQ(predictor->take_branch(0x4110, 0x80), tag_bits == 0);
+	}
+}
+
+TEST(BranchPredictor, target_buffer_and_return_stack) {
+	// 0x00: addi t1, zero, 8; addi a0, zero, 0; jal ra, 0x20; addi a0, a0, 1; jalr zero, 0(t1); nop; nop; nop
+	// 0x20: beq zero, zero, 0x28; jal ra, 0x40; jalr zero, 0(ra)
+	// the static predictor misses the forward beq, so the wrong-path call at 0x24 is fetched and must be undone
+	const uint32_t program[] = { 0x00800313, 0x00000513, 0x018000EF, 0x00150513, 0x00030067, 0x00000013, 0x00000013,
+	                             0x00000013, 0x00000463, 0x01C000EF, 0x00008067 };
+	const auto memory = std::shared_ptr<uint8_t[]>(new uint8_t[0x1000]{});
+	memcpy(memory.get(), program, sizeof(program));
+
+	auto predictor_core = RV32IM::Core(0, 320, 240, { RV32IM::PredictorType::STATIC });
+	predictor_core.load_memory_contents(memory, 0x1000);
+	predictor_core.step_clock(2000);
+
+	// one beq miss per iteration plus the first indirect jump, every return and later indirect jump is predicted
+	const auto iterations = predictor_core.get_registers()[RV32IM::a0];
+	EXPECT_GT(iterations, 100);
+	EXPECT_LE(predictor_core.get_performance_counters().get_mispredicts(), iterations + 2);
+}
+
+TEST(Lockstep, demo_images) {
+	for (const auto* name : { "asm_test.bin", "basic.bin", "bitmap_prg.bin", "image_prg.bin", "snake.bin", "test_prg.bin" })
+	{
+		// relative to this file, so the test does not depend on the working directory
+		std::ifstream file(std::filesystem::path(__FILE__).parent_path() / ".." / "Demo" / name, std::ios::binary);
+		ASSERT_TRUE(file) << name;
+		const std::vector<char> contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		uint32_t memory_size;
+		memcpy(&memory_size, contents.data() + 0x30, sizeof(memory_size));
+		const auto memory = std::shared_ptr<uint8_t[]>(new uint8_t[memory_size]{});
+		memcpy(memory.get(), contents.data(), std::min<size_t>(contents.size(), memory_size));
+
+		auto lockstep_core = RV32IM::Core();
+		lockstep_core.load_memory_contents(memory, memory_size);
+		RV32IM::LockstepChecker checker(lockstep_core, 64);
+		EXPECT_TRUE(checker.run(200000, 1000000)) << name << ": " << checker.describe_divergence();
+	}
+}
+
+TEST(Fuzzer, random_programs_match_reference) {
+	RV32IM::FuzzConfig config;
+	config.threads = 2;
+	RV32IM::Fuzzer fuzzer(config);
+	fuzzer.run(200);
+	EXPECT_EQ(fuzzer.get_programs_run(), 200);
+	for (const auto& failure : fuzzer.get_failures())
+		ADD_FAILURE() << "seed " << failure.seed << ": " << failure.description;
+}
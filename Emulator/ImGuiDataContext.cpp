@@ -171,6 +171,35 @@ CurrentWindow ImGuiDataContext::get_current_window() const
 void ImGuiDataContext::read_file_to_core(const string& file_path_name)
 {
     last_file_path = file_path_name;
+    load_error.clear();
+
+    // ELF files carry their own layout and entry point, leave the core untouched if one is malformed
+    if (RV32IM::ElfLoader::is_elf_file(file_path_name))
+    {
+        try
+        {
+            core->load_elf(file_path_name);
+        }
+        catch (const RV32IM::ElfLoadError& error)
+        {
+            load_error = error.what();
+            SDL_Log("Error: %s\n", error.what());
+        }
+        return;
+    }
+    if (RV32IM::CompressedImageLoader::is_compressed_image(file_path_name))
+    {
+        try
+        {
+            core->load_compressed_image(file_path_name);
+        }
+        catch (const RV32IM::CompressedImageError& error)
+        {
+            load_error = error.what();
+            SDL_Log("Error: %s\n", error.what());
+        }
+        return;
+    }
 
     if (ifstream file(file_path_name, std::ios::binary); file)
     {
@@ -286,6 +315,8 @@ void ImGuiDataContext::show_window_console()
         current_window = CurrentWindow::Console;
 
 	ImGui::Text("%.1f FPS (%.2f ms/frame) | %d (%d) ns/clock (%.1f MHz)", io.Framerate, 1000.0f / io.Framerate, core->get_average_clock_time(), core->get_average_processing_time(), 1000.0f / static_cast<float>(core->get_average_clock_time()));
+    if (!load_error.empty())
+        ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f), "%s: %s", last_file_path.c_str(), load_error.c_str());
     ImGui::Separator();
 
 	/*static const float footerHeightToReserve = ImGui::GetStyle().ItemSpacing.y + ImGui::GetFrameHeightWithSpacing();
@@ -434,7 +465,7 @@ void ImGuiDataContext::show_menu_bar_file()
         IGFD::FileDialogConfig config;
         config.path = ".";
         config.flags = ImGuiFileDialogFlags_Modal | ImGuiFileDialogFlags_CaseInsensitiveExtention;
-    	ImGuiFileDialog::Instance()->OpenDialog("ChooseFileDlgKey", "Choose File", ".bin", config);
+    	ImGuiFileDialog::Instance()->OpenDialog("ChooseFileDlgKey", "Choose File", "Programs{.bin,.elf,.lz4},.*", config);
     }
     ImGui::Separator();
     if (ImGui::MenuItem("Quit", "Alt+F4")) { quick_exit(0); }
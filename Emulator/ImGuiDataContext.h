@@ -46,6 +46,8 @@ private:
 	float last_scale;
 	CurrentWindow current_window; 
 	string last_file_path;
+	// why the last file could not be loaded, shown in the console until a load succeeds
+	string load_error;
 
 	SDL_Texture* emulator_screen;
 	shared_ptr<RV32IM::Core> core;
@@ -0,0 +1,57 @@
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "../Core/core.h"
+#include "../Core/fuzzer.h"
+
+// usage: Fuzzer [programs] [threads] [seed] [program length] [check interval]
+int main(const int argc, char* argv[])
+{
+	RV32IM::FuzzConfig config;
+	const uint64_t programs = argc > 1 ? std::strtoull(argv[1], nullptr, 0) : 1000000;
+	if (argc > 2)
+		config.threads = std::strtoul(argv[2], nullptr, 0);
+	if (argc > 3)
+		config.seed = std::strtoull(argv[3], nullptr, 0);
+	if (argc > 4)
+		config.program_length = std::strtoul(argv[4], nullptr, 0);
+	if (argc > 5)
+		config.check_interval = std::strtoul(argv[5], nullptr, 0);
+
+	RV32IM::Fuzzer fuzzer(config);
+	const auto start = std::chrono::steady_clock::now();
+	std::thread runner([&] { fuzzer.run(programs); });
+
+	// report progress once a second until the workers finish
+	std::atomic<bool> done = false;
+	std::thread reporter([&]
+		{
+			while (!done)
+			{
+				std::this_thread::sleep_for(std::chrono::seconds(1));
+				if (done)
+					break;
+				const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+				std::cout << fuzzer.get_programs_run() << " programs, " << std::fixed << std::setprecision(0)
+					<< fuzzer.get_programs_run() / seconds << " programs/s, " << fuzzer.get_instructions_checked() / seconds
+					<< " instructions/s, " << fuzzer.get_failures().size() << " failures\n";
+			}
+		});
+	runner.join();
+	done = true;
+	reporter.join();
+
+	const auto failures = fuzzer.get_failures();
+	for (const auto& failure : failures)
+	{
+		std::cout << "\nseed " << failure.seed << ": " << failure.description << "program:\n";
+		for (size_t i = 0; i < failure.program.size(); i++)
+			std::cout << RV32IM::to_hex(static_cast<RV32IM::unsigned_data>(i * 4)) << "  " << RV32IM::to_hex(failure.program[i]) << '\n';
+	}
+	std::cout << fuzzer.get_programs_run() << " programs, " << failures.size() << " failures\n";
+	return failures.empty() ? 0 : 1;
+}